@@ -196,16 +196,16 @@ Item {
 
             implicitSize: Sizes.itemWidth - Appearance.padding.normal * 2
 
-            Component.onCompleted: {
+            // File types are worked out in the background, so this has to follow them
+            source: {
                 const file = item.modelData;
                 if (file.isImage)
-                    source = Qt.resolvedUrl(file.path);
-                else if (!file.isDir)
-                    source = Quickshell.iconPath(file.mimeType.replace("/", "-"), "application-x-zerosize");
-                else if (root.dialog.cwd.length === 1 && ["Desktop", "Documents", "Downloads", "Music", "Pictures", "Public", "Templates", "Videos"].includes(file.name))
-                    source = Quickshell.iconPath(`folder-${file.name.toLowerCase()}`);
-                else
-                    source = Quickshell.iconPath("inode-directory");
+                    return Qt.resolvedUrl(file.path);
+                if (!file.isDir)
+                    return Quickshell.iconPath(file.mimeType.replace("/", "-"), "application-x-zerosize");
+                if (root.dialog.cwd.length === 1 && ["Desktop", "Documents", "Downloads", "Music", "Pictures", "Public", "Templates", "Videos"].includes(file.name))
+                    return Quickshell.iconPath(`folder-${file.name.toLowerCase()}`);
+                return Quickshell.iconPath("inode-directory");
             }
         }
 
@@ -252,6 +252,7 @@ Singleton {
             dragThreshold: launcher.dragThreshold,
             vimKeybinds: launcher.vimKeybinds,
             favouriteApps: launcher.favouriteApps,
+            appRanking: launcher.appRanking,
             hiddenApps: launcher.hiddenApps,
             useFuzzy: {
                 apps: launcher.useFuzzy.apps,
@@ -11,6 +11,7 @@ JsonObject {
     property int dragThreshold: 50
     property bool vimKeybinds: false
     property list<string> favouriteApps: []
+    property string appRanking: "frequency" // "frequency", "frecency" (recent launches count more) or "recent"
     property list<string> hiddenApps: []
     property UseFuzzy useFuzzy: UseFuzzy {}
     property Sizes sizes: Sizes {}
@@ -21,7 +21,7 @@ GridView {
     cellWidth: width / columnsCount
     cellHeight: 140 + Appearance.spacing.normal
 
-    model: Wallpapers.list
+    model: Wallpapers.files
 
     clip: true
 
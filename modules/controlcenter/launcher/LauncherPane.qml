@@ -296,7 +296,7 @@ Item {
                         Layout.fillWidth: true
                         Layout.fillHeight: true
 
-                        model: root.filteredApps
+                        model: root.searchText ? root.filteredApps : allAppsDb.model
                         spacing: Appearance.spacing.small / 2
                         clip: true
 
@@ -63,16 +63,23 @@ StyledListView {
     }
 
     onStateChanged: {
-        if (state === "scheme" || state === "variant")
+        if (state === "apps")
+            Apps.search(search.text);
+        else if (state === "scheme" || state === "variant")
             Schemes.reload();
     }
 
+    Component.onCompleted: {
+        if (state === "apps")
+            Apps.search(search.text);
+    }
+
     states: [
         State {
             name: "apps"
 
             PropertyChanges {
-                model.values: Apps.search(search.text)
+                root.model: Apps.results
                 root.delegate: appItem
             }
         },
@@ -132,7 +139,7 @@ StyledListView {
             }
             PropertyAction {
                 targets: [model, root]
-                properties: "values,delegate"
+                properties: "model,values,delegate"
             }
             ParallelAnimation {
                 Anim {
@@ -160,6 +167,23 @@ StyledListView {
         }
     }
 
+    Connections {
+        target: root.search
+
+        function onTextChanged(): void {
+            if (root.state === "apps")
+                Apps.search(root.search.text);
+        }
+    }
+
+    Connections {
+        target: Apps.results
+
+        function onModelReset(): void {
+            root.currentIndex = 0;
+        }
+    }
+
     StyledScrollBar.vertical: StyledScrollBar {
         flickable: root
     }
@@ -94,7 +94,7 @@ Item {
                         else
                             currentItem.modelData.onClicked(list.currentList);
                     } else {
-                        Apps.launch(currentItem.modelData);
+                        Apps.launch(currentItem.entry);
                         root.visibilities.launcher = false;
                     }
                 }
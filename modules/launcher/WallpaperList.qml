@@ -15,6 +15,7 @@ PathView {
     required property var panels
     required property var content
 
+    readonly property string query: search.text.split(" ").slice(1).join(" ")
     readonly property int itemWidth: Config.launcher.sizes.wallpaperWidth * 0.8 + Appearance.padding.larger * 2
 
     readonly property int numItems: {
@@ -35,7 +36,7 @@ PathView {
             return 0;
 
         const maxItemsOnScreen = Math.floor(maxWidth / itemWidth);
-        const visible = Math.min(maxItemsOnScreen, Config.launcher.maxWallpapers, scriptModel.values.length);
+        const visible = Math.min(maxItemsOnScreen, Config.launcher.maxWallpapers, count);
 
         if (visible === 2)
             return 1;
@@ -44,16 +45,15 @@ PathView {
         return visible;
     }
 
-    model: ScriptModel {
-        id: scriptModel
-
-        readonly property string search: root.search.text.split(" ").slice(1).join(" ")
-
-        values: Wallpapers.query(search)
-        onValuesChanged: root.currentIndex = search ? 0 : values.findIndex(w => w.path === Wallpapers.actualCurrent)
+    function resetCurrentIndex(): void {
+        currentIndex = query ? 0 : Wallpapers.files.paths.indexOf(Wallpapers.actualCurrent);
     }
 
-    Component.onCompleted: currentIndex = Wallpapers.list.findIndex(w => w.path === Wallpapers.actualCurrent)
+    // Shown straight from the file model when not searching, so entries are only made for visible wallpapers
+    model: query ? results : Wallpapers.files
+
+    onModelChanged: resetCurrentIndex()
+    Component.onCompleted: resetCurrentIndex()
     Component.onDestruction: Wallpapers.stopPreview()
 
     onCurrentItemChanged: {
@@ -74,6 +74,25 @@ PathView {
         visibilities: root.visibilities
     }
 
+    ScriptModel {
+        id: results
+
+        values: root.query ? Wallpapers.query(root.query) : []
+        onValuesChanged: {
+            if (root.query)
+                root.currentIndex = 0;
+        }
+    }
+
+    Connections {
+        target: Wallpapers.files
+
+        function onEntriesChanged(): void {
+            if (!root.query)
+                root.resetCurrentIndex();
+        }
+    }
+
     path: Path {
         startY: root.height / 2
 
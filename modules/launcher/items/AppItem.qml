@@ -1,6 +1,7 @@
 import QtQuick
 import Quickshell
 import Quickshell.Widgets
+import Caelestia
 import qs.components
 import qs.services
 import qs.config
@@ -10,8 +11,9 @@ import qs.modules.launcher.services
 Item {
     id: root
 
-    required property DesktopEntry modelData
+    required property AppEntry modelData
     required property DrawerVisibilities visibilities
+    readonly property DesktopEntry entry: modelData?.entry ?? null
 
     implicitHeight: Config.launcher.sizes.itemHeight
 
@@ -20,7 +22,7 @@ Item {
 
     StateLayer {
         function onClicked(): void {
-            Apps.launch(root.modelData);
+            Apps.launch(root.entry);
             root.visibilities.launcher = false;
         }
 
@@ -37,7 +39,7 @@ Item {
             id: icon
 
             asynchronous: true
-            source: Quickshell.iconPath(root.modelData?.icon, "image-missing")
+            source: Quickshell.iconPath(root.entry?.icon, "image-missing")
             implicitSize: parent.height * 0.8
 
             anchors.verticalCenter: parent.verticalCenter
@@ -54,14 +56,14 @@ Item {
             StyledText {
                 id: name
 
-                text: root.modelData?.name ?? ""
+                text: root.entry?.name ?? ""
                 font.pointSize: Appearance.font.size.normal
             }
 
             StyledText {
                 id: comment
 
-                text: (root.modelData?.comment || root.modelData?.genericName || root.modelData?.name) ?? ""
+                text: (root.entry?.comment || root.entry?.genericName || root.entry?.name) ?? ""
                 font.pointSize: Appearance.font.size.small
                 color: Colours.palette.m3outline
 
@@ -78,7 +80,7 @@ Item {
             asynchronous: true
             anchors.verticalCenter: parent.verticalCenter
             anchors.right: parent.right
-            active: root.modelData && Strings.testRegexList(Config.launcher.favouriteApps, root.modelData.id)
+            active: root.entry && Strings.testRegexList(Config.launcher.favouriteApps, root.entry.id)
 
             sourceComponent: MaterialIcon {
                 text: "favorite"
@@ -8,6 +8,9 @@ import qs.utils
 Searcher {
     id: root
 
+    // Narrows list to apps run in a terminal, for the terminal prefix
+    property bool terminalOnly
+
     function launch(entry: DesktopEntry): void {
         appDb.incrementFrequency(entry.id);
 
@@ -23,8 +26,10 @@ Searcher {
             });
     }
 
-    function search(search: string): list<var> {
+    // Searches into results off the GUI thread, its rows are AppEntry
+    function search(search: string): void {
         const prefix = Config.launcher.specialPrefix;
+        terminalOnly = search.startsWith(`${prefix}t `);
 
         if (search.startsWith(`${prefix}i `)) {
             keys = ["id", "name"];
@@ -51,21 +56,16 @@ Searcher {
             keys = ["name"];
             weights = [1];
 
-            if (!search.startsWith(`${prefix}t `))
-                return query(search).map(e => e.entry);
+            if (!terminalOnly) {
+                queryAsync(search);
+                return;
+            }
         }
 
-        const results = query(search.slice(prefix.length + 2)).map(e => e.entry);
-        if (search.startsWith(`${prefix}t `))
-            return results.filter(a => a.runInTerminal);
-        return results;
-    }
-
-    function selector(item: var): string {
-        return keys.map(k => item[k]).join(" ");
+        queryAsync(search.slice(prefix.length + 2));
     }
 
-    list: appDb.apps
+    list: terminalOnly ? [...appDb.apps].filter(a => a.entry.runInTerminal) : appDb.apps
     useFuzzy: Config.launcher.useFuzzy.apps
 
     AppDb {
@@ -73,6 +73,14 @@ Searcher {
 
         path: `${Paths.state}/apps.sqlite`
         favouriteApps: Config.launcher.favouriteApps
+        rankingMode: {
+            const ranking = Config.launcher.appRanking;
+            if (ranking === "frecency")
+                return AppDb.Frecency;
+            if (ranking === "recent")
+                return AppDb.Recent;
+            return AppDb.Frequency;
+        }
         entries: DesktopEntries.applications.values.filter(a => !Strings.testRegexList(Config.launcher.hiddenApps, a.id))
     }
 }
@@ -17,10 +17,6 @@ Searcher {
         return search.slice(`${Config.launcher.actionPrefix}scheme `.length);
     }
 
-    function selector(item: var): string {
-        return `${item.name} ${item.flavour}`;
-    }
-
     function reload(): void {
         getCurrent.running = true;
     }
@@ -1,46 +1,66 @@
 #include "arcgauge.hpp"
 
+#include "arcgaugematerial.hpp"
 #include <QtMath>
-#include <qpainter.h>
-#include <qpen.h>
+#include <qsgnode.h>
 
 namespace caelestia::internal {
 
 ArcGauge::ArcGauge(QQuickItem* parent)
-    : QQuickPaintedItem(parent) {
-    setAntialiasing(true);
+    : QQuickItem(parent) {
+    setFlag(ItemHasContents, true);
 }
 
-void ArcGauge::paint(QPainter* painter) {
+QSGNode* ArcGauge::updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData*) {
     const qreal w = width();
     const qreal h = height();
-    const qreal side = qMin(w, h);
-    const qreal radius = (side - m_lineWidth - 2.0) / 2.0;
-    const qreal cx = w / 2.0;
-    const qreal cy = h / 2.0;
-
-    const QRectF arcRect(cx - radius, cy - radius, radius * 2.0, radius * 2.0);
-
-    // Convert from Canvas convention (CW radians from 3 o'clock) to QPainter (CCW 1/16th degrees)
-    const int startAngle16 = qRound(-(m_startAngle * 180.0 / M_PI) * 16.0);
-    const int sweepAngle16 = qRound(-(m_sweepAngle * 180.0 / M_PI) * 16.0);
-
-    painter->setRenderHint(QPainter::Antialiasing, true);
-
-    // Draw track arc
-    QPen trackPen(m_trackColor, m_lineWidth);
-    trackPen.setCapStyle(Qt::RoundCap);
-    painter->setPen(trackPen);
-    painter->setBrush(Qt::NoBrush);
-    painter->drawArc(arcRect, startAngle16, sweepAngle16);
-
-    // Draw value arc
-    if (m_percentage > 0.0) {
-        const int valueSweep16 = qRound(static_cast<qreal>(sweepAngle16) * m_percentage);
-        QPen valuePen(m_accentColor, m_lineWidth);
-        valuePen.setCapStyle(Qt::RoundCap);
-        painter->setPen(valuePen);
-        painter->drawArc(arcRect, startAngle16, valueSweep16);
+    if (w <= 0 || h <= 0) {
+        delete oldNode;
+        m_geometryDirty = true;
+        return nullptr;
+    }
+
+    auto* node = static_cast<QSGGeometryNode*>(oldNode);
+    if (!node) {
+        node = new QSGGeometryNode;
+
+        auto* geometry = new QSGGeometry(QSGGeometry::defaultAttributes_TexturedPoint2D(), 4);
+        geometry->setDrawingMode(QSGGeometry::DrawTriangleStrip);
+        node->setGeometry(geometry);
+        node->setFlag(QSGNode::OwnsGeometry);
+
+        node->setMaterial(new ArcGaugeMaterial);
+        node->setFlag(QSGNode::OwnsMaterial);
+        m_geometryDirty = true;
+    }
+
+    // A single quad, texture coordinates are positions relative to the centre so the shader works in item units
+    if (m_geometryDirty) {
+        const QRectF rect(0, 0, w, h);
+        QSGGeometry::updateTexturedRectGeometry(node->geometry(), rect, rect.translated(-w / 2.0, -h / 2.0));
+        node->markDirty(QSGNode::DirtyGeometry);
+        m_geometryDirty = false;
+    }
+
+    // Everything else is a uniform, so animating the percentage never touches the geometry
+    auto* material = static_cast<ArcGaugeMaterial*>(node->material());
+    material->m_radius = static_cast<float>((qMin(w, h) - m_lineWidth - 2.0) / 2.0);
+    material->m_halfWidth = static_cast<float>(m_lineWidth / 2.0);
+    material->m_startAngle = static_cast<float>(m_startAngle);
+    material->m_trackSweep = static_cast<float>(m_sweepAngle);
+    material->m_valueSweep = m_percentage > 0.0 ? static_cast<float>(m_sweepAngle * m_percentage) : 0.0f;
+    material->m_trackColor = m_trackColor;
+    material->m_accentColor = m_accentColor;
+    node->markDirty(QSGNode::DirtyMaterial);
+
+    return node;
+}
+
+void ArcGauge::geometryChange(const QRectF& newGeometry, const QRectF& oldGeometry) {
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size()) {
+        m_geometryDirty = true;
+        update();
     }
 }
 
@@ -3,11 +3,11 @@
 #include <qcolor.h>
 #include <qobject.h>
 #include <qqmlintegration.h>
-#include <qquickpainteditem.h>
+#include <qquickitem.h>
 
 namespace caelestia::internal {
 
-class ArcGauge : public QQuickPaintedItem {
+class ArcGauge : public QQuickItem {
     Q_OBJECT
     QML_ELEMENT
 
@@ -21,8 +21,6 @@ class ArcGauge : public QQuickPaintedItem {
 public:
     explicit ArcGauge(QQuickItem* parent = nullptr);
 
-    void paint(QPainter* painter) override;
-
     [[nodiscard]] qreal percentage() const;
     void setPercentage(qreal percentage);
 
@@ -49,6 +47,10 @@ signals:
     void sweepAngleChanged();
     void lineWidthChanged();
 
+protected:
+    QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data) override;
+    void geometryChange(const QRectF& newGeometry, const QRectF& oldGeometry) override;
+
 private:
     qreal m_percentage = 0.0;
     QColor m_accentColor;
@@ -56,6 +58,7 @@ private:
     qreal m_startAngle = 0.75 * M_PI;
     qreal m_sweepAngle = 1.5 * M_PI;
     qreal m_lineWidth = 10.0;
+    bool m_geometryDirty = true;
 };
 
 } // namespace caelestia::internal
@@ -0,0 +1,77 @@
+#include "arcgaugematerial.hpp"
+
+#include <cstring>
+
+namespace caelestia::internal {
+
+namespace {
+
+void writeColor(QByteArray* buf, int offset, const QColor& color) {
+    const float c[4] = {
+        static_cast<float>(color.redF()),
+        static_cast<float>(color.greenF()),
+        static_cast<float>(color.blueF()),
+        static_cast<float>(color.alphaF()),
+    };
+    memcpy(buf->data() + offset, c, 16);
+}
+
+} // namespace
+
+ArcGaugeMaterial::ArcGaugeMaterial() {
+    setFlag(Blending);
+}
+
+QSGMaterialType* ArcGaugeMaterial::type() const {
+    static QSGMaterialType s_type;
+    return &s_type;
+}
+
+QSGMaterialShader* ArcGaugeMaterial::createShader(QSGRendererInterface::RenderMode) const {
+    return new ArcGaugeMaterialShader;
+}
+
+int ArcGaugeMaterial::compare(const QSGMaterial* other) const {
+    // Every gauge has its own uniforms, so never share state
+    if (this < other)
+        return -1;
+    if (this > other)
+        return 1;
+    return 0;
+}
+
+ArcGaugeMaterialShader::ArcGaugeMaterialShader() {
+    setShaderFileName(VertexStage, QStringLiteral(":/shaders/arcgauge.vert.qsb"));
+    setShaderFileName(FragmentStage, QStringLiteral(":/shaders/arcgauge.frag.qsb"));
+}
+
+bool ArcGaugeMaterialShader::updateUniformData(RenderState& state, QSGMaterial* newMaterial, QSGMaterial* oldMaterial) {
+    Q_UNUSED(oldMaterial);
+    auto* mat = static_cast<ArcGaugeMaterial*>(newMaterial);
+    QByteArray* buf = state.uniformData();
+    Q_ASSERT(buf->size() >= 128);
+
+    if (state.isMatrixDirty()) {
+        const QMatrix4x4 m = state.combinedMatrix();
+        memcpy(buf->data(), m.constData(), 64);
+    }
+    if (state.isOpacityDirty()) {
+        const float opacity = state.opacity();
+        memcpy(buf->data() + 64, &opacity, 4);
+    }
+
+    // Arc shape (offset 68)
+    memcpy(buf->data() + 68, &mat->m_radius, 4);
+    memcpy(buf->data() + 72, &mat->m_halfWidth, 4);
+    memcpy(buf->data() + 76, &mat->m_startAngle, 4);
+    memcpy(buf->data() + 80, &mat->m_trackSweep, 4);
+    memcpy(buf->data() + 84, &mat->m_valueSweep, 4);
+
+    // Colors as vec4 (offsets 96 and 112, 16 bytes each)
+    writeColor(buf, 96, mat->m_trackColor);
+    writeColor(buf, 112, mat->m_accentColor);
+
+    return true;
+}
+
+} // namespace caelestia::internal
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <qcolor.h>
+#include <qsgmaterial.h>
+#include <qsgmaterialshader.h>
+
+namespace caelestia::internal {
+
+class ArcGaugeMaterial : public QSGMaterial {
+public:
+    ArcGaugeMaterial();
+
+    QSGMaterialType* type() const override;
+    QSGMaterialShader* createShader(QSGRendererInterface::RenderMode) const override;
+    int compare(const QSGMaterial* other) const override;
+
+    float m_radius = 0;
+    float m_halfWidth = 0;
+    float m_startAngle = 0;
+    float m_trackSweep = 0;
+    float m_valueSweep = 0;
+    QColor m_trackColor;
+    QColor m_accentColor;
+};
+
+class ArcGaugeMaterialShader : public QSGMaterialShader {
+public:
+    ArcGaugeMaterialShader();
+    bool updateUniformData(RenderState& state, QSGMaterial* newMaterial, QSGMaterial* oldMaterial) override;
+};
+
+} // namespace caelestia::internal
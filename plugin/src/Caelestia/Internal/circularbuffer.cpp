@@ -35,6 +35,7 @@ void CircularBuffer::setCapacity(int capacity) {
 
     emit capacityChanged();
     emit countChanged();
+    emit reset();
     emit valuesChanged();
 }
 
@@ -70,6 +71,7 @@ void CircularBuffer::push(qreal value) {
         m_count++;
         emit countChanged();
     }
+    emit pushed(value);
     emit valuesChanged();
 }
 
@@ -80,6 +82,7 @@ void CircularBuffer::clear() {
     m_head = 0;
     m_count = 0;
     emit countChanged();
+    emit reset();
     emit valuesChanged();
 }
 
@@ -33,6 +33,9 @@ signals:
     void capacityChanged();
     void countChanged();
     void valuesChanged();
+    // Finer grained than valuesChanged, so consumers can update incrementally
+    void pushed(qreal value);
+    void reset();
 
 private:
     QVector<qreal> m_data;
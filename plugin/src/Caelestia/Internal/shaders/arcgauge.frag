@@ -0,0 +1,54 @@
+#version 440
+
+layout(location = 0) in vec2 coord;
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 qt_Matrix;
+    float qt_Opacity;
+    float radius;
+    float halfWidth;
+    float startAngle;
+    float trackSweep;
+    float valueSweep;
+    vec4 trackColor;
+    vec4 accentColor;
+};
+
+const float TAU = 6.28318530718;
+
+// Signed distance to an arc with round caps, angles are clockwise from 3 o'clock
+float arcDistance(vec2 p, float start, float sweep) {
+    if (sweep < 0.0) {
+        start += sweep;
+        sweep = -sweep;
+    }
+
+    float ring = abs(length(p) - radius) - halfWidth;
+    if (sweep >= TAU)
+        return ring;
+
+    float rel = mod(atan(p.y, p.x) - start, TAU);
+    if (rel <= sweep)
+        return ring;
+
+    vec2 a = radius * vec2(cos(start), sin(start));
+    vec2 b = radius * vec2(cos(start + sweep), sin(start + sweep));
+    return min(length(p - a), length(p - b)) - halfWidth;
+}
+
+void main() {
+    // Size of a pixel in item units, so edges stay one pixel soft at any scale
+    float aa = max(0.5 * (fwidth(coord.x) + fwidth(coord.y)), 1e-4);
+
+    float track = clamp(0.5 - arcDistance(coord, startAngle, trackSweep) / aa, 0.0, 1.0);
+    vec4 color = vec4(trackColor.rgb * trackColor.a, trackColor.a) * track;
+
+    if (valueSweep != 0.0) {
+        float value = clamp(0.5 - arcDistance(coord, startAngle, valueSweep) / aa, 0.0, 1.0);
+        vec4 accent = vec4(accentColor.rgb * accentColor.a, accentColor.a) * value;
+        color = accent + color * (1.0 - accent.a);
+    }
+
+    fragColor = color * qt_Opacity;
+}
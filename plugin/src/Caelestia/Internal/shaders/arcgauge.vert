@@ -0,0 +1,24 @@
+#version 440
+
+layout(location = 0) in vec4 qt_VertexPosition;
+layout(location = 1) in vec2 qt_VertexTexCoord;
+
+layout(location = 0) out vec2 coord;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 qt_Matrix;
+    float qt_Opacity;
+    float radius;
+    float halfWidth;
+    float startAngle;
+    float trackSweep;
+    float valueSweep;
+    vec4 trackColor;
+    vec4 accentColor;
+};
+
+void main() {
+    // Position relative to the arc centre in item units
+    coord = qt_VertexTexCoord;
+    gl_Position = qt_Matrix * qt_VertexPosition;
+}
@@ -0,0 +1,21 @@
+#version 440
+
+layout(location = 0) in vec2 edge;
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 qt_Matrix;
+    float qt_Opacity;
+    float scroll;
+    float stepX;
+    float maxValue;
+    vec2 size;
+    float halfWidth;
+    vec4 color;
+};
+
+void main() {
+    // edge.y is 0 for fills, which need no edge antialiasing
+    float alpha = edge.y > 0.0 ? clamp(halfWidth + 0.5 - abs(edge.x), 0.0, 1.0) : 1.0;
+    fragColor = vec4(color.rgb * color.a, color.a) * alpha * qt_Opacity;
+}
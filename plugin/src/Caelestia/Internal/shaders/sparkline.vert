@@ -0,0 +1,56 @@
+#version 440
+
+// Points are in sample space: x is the sample ordinal and y the raw value
+layout(location = 0) in vec4 qt_VertexPosition;
+layout(location = 1) in vec2 prevPoint;
+layout(location = 2) in vec2 nextPoint;
+layout(location = 3) in float side;
+
+layout(location = 0) out vec2 edge;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 qt_Matrix;
+    float qt_Opacity;
+    float scroll;
+    float stepX;
+    float maxValue;
+    vec2 size;
+    float halfWidth;
+    vec4 color;
+};
+
+vec2 toItem(vec2 p) {
+    return vec2(size.x - stepX * (scroll - p.x), size.y - p.y / maxValue * size.y);
+}
+
+vec2 direction(vec2 from, vec2 to) {
+    vec2 d = to - from;
+    float len = length(d);
+    return len > 1e-4 ? d / len : vec2(0.0);
+}
+
+void main() {
+    vec2 p = toItem(qt_VertexPosition.xy);
+
+    if (side != 0.0) {
+        // Extrude the line in item space so the width stays constant while scrolling and rescaling
+        vec2 d0 = direction(toItem(prevPoint), p);
+        vec2 d1 = direction(p, toItem(nextPoint));
+        vec2 tangent = d0 + d1;
+        tangent = length(tangent) > 1e-4 ? normalize(tangent) : (length(d1) > 0.0 ? d1 : d0);
+        vec2 normal = vec2(-tangent.y, tangent.x);
+
+        // Miter join, clamped so sharp spikes don't shoot off
+        vec2 segNormal = length(d1) > 0.0 ? vec2(-d1.y, d1.x) : vec2(-d0.y, d0.x);
+        float miter = 1.0 / max(abs(dot(normal, segNormal)), 0.5);
+
+        // One extra pixel on each side for antialiasing
+        float extent = halfWidth + 1.0;
+        p += normal * side * extent * miter;
+        edge = vec2(side * extent, 1.0);
+    } else {
+        edge = vec2(0.0);
+    }
+
+    gl_Position = qt_Matrix * vec4(p, 0.0, 1.0);
+}
@@ -0,0 +1,29 @@
+#version 440
+
+layout(location = 0) in vec3 coord;
+layout(location = 1) in vec3 shape;
+layout(location = 0) out vec4 fragColor;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 qt_Matrix;
+    float qt_Opacity;
+    vec4 primaryColor;
+    vec4 secondaryColor;
+};
+
+float sdRoundedTop(vec2 p, vec2 size, float radius) {
+    // Only the top corners are rounded, bars sit flat on the bottom edge
+    vec2 q = p - size * 0.5;
+    float r = q.y < 0.0 ? radius : 0.0;
+    vec2 d = abs(q) - size * 0.5 + r;
+    return min(max(d.x, d.y), 0.0) + length(max(d, 0.0)) - r;
+}
+
+void main() {
+    float dist = sdRoundedTop(coord.xy, shape.xy, shape.z);
+    float fw = max(fwidth(dist), 1e-4);
+    float alpha = clamp(0.5 - dist / fw, 0.0, 1.0);
+
+    vec4 color = mix(primaryColor, secondaryColor, coord.z);
+    fragColor = vec4(color.rgb * color.a, color.a) * alpha * qt_Opacity;
+}
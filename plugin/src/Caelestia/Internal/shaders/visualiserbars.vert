@@ -0,0 +1,22 @@
+#version 440
+
+layout(location = 0) in vec4 qt_VertexPosition;
+layout(location = 1) in vec3 barCoord;
+layout(location = 2) in vec3 barShape;
+
+layout(location = 0) out vec3 coord;
+layout(location = 1) out vec3 shape;
+
+layout(std140, binding = 0) uniform buf {
+    mat4 qt_Matrix;
+    float qt_Opacity;
+    vec4 primaryColor;
+    vec4 secondaryColor;
+};
+
+void main() {
+    // coord = (x, y) inside the bar from its top left + gradient position, shape = (width, height, radius)
+    coord = barCoord;
+    shape = barShape;
+    gl_Position = qt_Matrix * qt_VertexPosition;
+}
@@ -1,167 +1,412 @@
 #include "sparklineitem.hpp"
 
-#include <qpainter.h>
-#include <qpainterpath.h>
-#include <qpen.h>
+#include "sparklinematerial.hpp"
+#include <algorithm>
+#include <qsgnode.h>
+#include <utility>
 
 namespace caelestia::internal {
 
-SparklineItem::SparklineItem(QQuickItem* parent)
-    : QQuickPaintedItem(parent) {
-    setAntialiasing(true);
+namespace {
+
+// Ordinals are floats on the GPU, so restart them before the scroll offset loses sub-sample precision
+constexpr quint32 MAX_ORDINAL = 1 << 16;
+
+SparklineVertex* vertices(QSGGeometry* geometry) {
+    return static_cast<SparklineVertex*>(geometry->vertexData());
+}
+
+QSGGeometryNode* createNode(QSGGeometry::DrawingMode mode) {
+    auto* geometry = new QSGGeometry(sparklineAttributes(), 0);
+    geometry->setDrawingMode(mode);
+
+    auto* node = new QSGGeometryNode;
+    node->setGeometry(geometry);
+    node->setFlag(QSGNode::OwnsGeometry);
+    node->setMaterial(new SparklineMaterial);
+    node->setFlag(QSGNode::OwnsMaterial);
+    return node;
+}
+
+// Each sample is two vertices in both strips: the line is extruded to either side in the vertex shader, and the fill
+// runs from the sample down to zero. Vertices are stored in sample space so scrolling and rescaling only touch
+// uniforms.
+//
+// The strips are rings of capacity + 1 slots, sample n living in slot n % slots, so a push only writes its own slot
+// and the spare one after it. The spare repeats the last vertex of the newest sample and the first of the oldest,
+// which turns every triangle across the seam into a degenerate one. Once full, an extra slot past the end mirrors
+// slot 0 so the strip also bridges the wrap. Slots that were never written all hold the same zeroed vertex and
+// collapse the same way.
+class SparklineSeriesNode : public QSGNode {
+public:
+    explicit SparklineSeriesNode(SparklineSeries* series)
+        : m_series(series)
+        , m_line(createNode(QSGGeometry::DrawTriangleStrip))
+        , m_fill(createNode(QSGGeometry::DrawTriangleStrip)) {
+        // Fill drawn over the line to match the painted version
+        appendChildNode(m_line);
+        appendChildNode(m_fill);
+    }
+
+    [[nodiscard]] bool isSubtreeBlocked() const override { return m_hidden; }
+
+    void sync(qreal stepX, qreal maxValue, qreal slideProgress, qreal lineWidth, const QSizeF& size) {
+        if (!m_series->buffer())
+            return;
+
+        const bool reset = m_series->takeReset();
+        const auto pending = m_series->takePending();
+        if (reset || !m_initialised || m_newest + static_cast<quint32>(pending.size()) >= MAX_ORDINAL) {
+            // Pending values are already in the buffer, so a rebuild covers them
+            rebuild();
+        } else if (!pending.isEmpty()) {
+            for (const qreal value : pending)
+                append(value);
+            m_line->markDirty(QSGNode::DirtyGeometry);
+            m_fill->markDirty(QSGNode::DirtyGeometry);
+        }
+
+        const bool hidden = m_count < 2 || stepX <= 0;
+        if (m_hidden != hidden) {
+            m_hidden = hidden;
+            markDirty(QSGNode::DirtySubtreeBlocked);
+        }
+        if (hidden)
+            return;
+
+        QColor fillColor = m_series->color();
+        fillColor.setAlphaF(static_cast<float>(m_series->fillAlpha()));
+
+        const float scroll = static_cast<float>(m_newest) + static_cast<float>(slideProgress) - 1.0f;
+        updateMaterial(m_line, m_series->color(), scroll, stepX, maxValue, lineWidth / 2, size);
+        updateMaterial(m_fill, fillColor, scroll, stepX, maxValue, lineWidth / 2, size);
+    }
+
+private:
+    static void updateMaterial(QSGGeometryNode* node, const QColor& color, float scroll, qreal stepX, qreal maxValue,
+        qreal halfWidth, const QSizeF& size) {
+        auto* material = static_cast<SparklineMaterial*>(node->material());
+        material->m_color = color;
+        material->m_scroll = scroll;
+        material->m_stepX = static_cast<float>(stepX);
+        material->m_maxValue = static_cast<float>(std::max(maxValue, 1e-6));
+        material->m_width = static_cast<float>(size.width());
+        material->m_height = static_cast<float>(size.height());
+        material->m_halfWidth = static_cast<float>(halfWidth);
+        node->markDirty(QSGNode::DirtyMaterial);
+    }
+
+    void rebuild() {
+        const auto* buffer = m_series->buffer();
+        m_count = buffer->count();
+        m_slots = std::max(buffer->capacity(), m_count) + 1;
+        m_newest = m_count > 0 ? static_cast<quint32>(m_count - 1) : 0;
+        m_initialised = true;
+
+        for (auto* node : { m_line, m_fill }) {
+            auto* geometry = node->geometry();
+            geometry->allocate((m_slots + 1) * 2);
+            std::fill_n(vertices(geometry), (m_slots + 1) * 2, SparklineVertex{});
+        }
+        for (int i = 0; i < m_count; ++i)
+            writeSample(i, i > 0, static_cast<float>(i), static_cast<float>(buffer->at(i)));
+        writeSeam();
+
+        m_line->markDirty(QSGNode::DirtyGeometry);
+        m_fill->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    void append(qreal value) {
+        if (m_slots < 2)
+            return;
+
+        if (m_count > 0)
+            m_newest++;
+        // Lands on the spare slot, and once full the oldest sample becomes the new spare
+        writeSample(newestSlot(), m_count > 0, static_cast<float>(m_newest), static_cast<float>(value));
+        if (m_count < m_slots - 1)
+            m_count++;
+        writeSeam();
+    }
+
+    [[nodiscard]] int newestSlot() const { return static_cast<int>(m_newest % static_cast<quint32>(m_slots)); }
+
+    void writeSample(int slot, bool linked, float ordinal, float value) {
+        auto* line = vertices(m_line->geometry()) + slot * 2;
+        auto* fill = vertices(m_fill->geometry()) + slot * 2;
+
+        line[0] = { ordinal, value, ordinal, value, ordinal, value, -1.0f };
+        line[1] = { ordinal, value, ordinal, value, ordinal, value, 1.0f };
+        fill[0] = { ordinal, value, ordinal, value, ordinal, value, 0.0f };
+        fill[1] = { ordinal, 0.0f, ordinal, 0.0f, ordinal, 0.0f, 0.0f };
+
+        if (linked) {
+            auto* prev = vertices(m_line->geometry()) + (slot + m_slots - 1) % m_slots * 2;
+            for (int i = 0; i < 2; ++i) {
+                line[i].prevX = prev[i].x;
+                line[i].prevY = prev[i].y;
+                prev[i].nextX = ordinal;
+                prev[i].nextY = value;
+            }
+        }
+    }
+
+    void writeSeam() {
+        const int newest = newestSlot();
+        const int spare = (newest + 1) % m_slots;
+        for (auto* node : { m_line, m_fill }) {
+            auto* v = vertices(node->geometry());
+            v[spare * 2] = v[newest * 2 + 1];
+            v[spare * 2 + 1] = v[(spare + 1) % m_slots * 2];
+            if (m_count == m_slots - 1) {
+                v[m_slots * 2] = v[0];
+                v[m_slots * 2 + 1] = v[1];
+            }
+        }
+    }
+
+    SparklineSeries* m_series;
+    QSGGeometryNode* m_line;
+    QSGGeometryNode* m_fill;
+    int m_slots = 0;
+    int m_count = 0;
+    quint32 m_newest = 0;
+    bool m_initialised = false;
+    bool m_hidden = true;
+};
+
+} // namespace
+
+SparklineSeries::SparklineSeries(QObject* parent)
+    : QObject(parent) {}
+
+CircularBuffer* SparklineSeries::buffer() const {
+    return m_buffer;
 }
 
-void SparklineItem::paint(QPainter* painter) {
-    const bool has1 = m_line1 && m_line1->count() >= 2;
-    const bool has2 = m_line2 && m_line2->count() >= 2;
-    if (!has1 && !has2)
+void SparklineSeries::setBuffer(CircularBuffer* buffer) {
+    if (m_buffer == buffer)
         return;
+    if (m_buffer)
+        disconnect(m_buffer, nullptr, this, nullptr);
+
+    m_buffer = buffer;
+    m_reset = true;
+    m_pending.clear();
+
+    if (buffer) {
+        connect(buffer, &CircularBuffer::pushed, this, [this](qreal value) {
+            // Nothing is consuming updates while hidden, so collapse into a rebuild rather than growing forever
+            if (m_pending.size() >= m_buffer->capacity())
+                m_reset = true;
+            if (m_reset)
+                m_pending.clear();
+            else
+                m_pending << value;
+            emit dataChanged();
+        });
+        connect(buffer, &CircularBuffer::reset, this, [this]() {
+            m_reset = true;
+            m_pending.clear();
+            emit dataChanged();
+        });
+        connect(buffer, &QObject::destroyed, this, [this]() {
+            m_buffer = nullptr;
+            m_pending.clear();
+            emit bufferChanged();
+        });
+    }
 
-    painter->setRenderHint(QPainter::Antialiasing, true);
+    emit bufferChanged();
+}
 
-    // Draw line1 first (behind), then line2 (in front)
-    if (has1)
-        drawLine(painter, m_line1, m_line1Color, m_line1FillAlpha);
-    if (has2)
-        drawLine(painter, m_line2, m_line2Color, m_line2FillAlpha);
+QColor SparklineSeries::color() const {
+    return m_color;
 }
 
-void SparklineItem::drawLine(QPainter* painter, CircularBuffer* buffer, const QColor& color, qreal fillAlpha) {
-    if (m_historyLength < 2)
+void SparklineSeries::setColor(const QColor& color) {
+    if (m_color == color)
         return;
+    m_color = color;
+    emit colorChanged();
+}
 
-    const qreal w = width();
-    const qreal h = height();
-    const int len = buffer->count();
-    const qreal stepX = w / static_cast<qreal>(m_historyLength - 1);
-    const qreal startX = w - (len - 1) * stepX - stepX * m_slideProgress + stepX;
-
-    // Build line path
-    QPainterPath linePath;
-    linePath.moveTo(startX, h - (buffer->at(0) / m_maxValue) * h);
-    for (int i = 1; i < len; ++i) {
-        const qreal x = startX + i * stepX;
-        const qreal y = h - (buffer->at(i) / m_maxValue) * h;
-        linePath.lineTo(x, y);
-    }
+qreal SparklineSeries::fillAlpha() const {
+    return m_fillAlpha;
+}
 
-    // Stroke the line
-    QPen pen(color, m_lineWidth);
-    pen.setCapStyle(Qt::RoundCap);
-    pen.setJoinStyle(Qt::RoundJoin);
-    painter->setPen(pen);
-    painter->setBrush(Qt::NoBrush);
-    painter->drawPath(linePath);
-
-    // Fill under the line
-    QPainterPath fillPath = linePath;
-    fillPath.lineTo(startX + (len - 1) * stepX, h);
-    fillPath.lineTo(startX, h);
-    fillPath.closeSubpath();
-
-    QColor fillColor = color;
-    fillColor.setAlphaF(static_cast<float>(fillAlpha));
-    painter->setPen(Qt::NoPen);
-    painter->setBrush(fillColor);
-    painter->drawPath(fillPath);
-}
-
-void SparklineItem::connectBuffer(CircularBuffer* buffer) {
-    if (!buffer)
+void SparklineSeries::setFillAlpha(qreal alpha) {
+    if (qFuzzyCompare(m_fillAlpha, alpha))
         return;
+    m_fillAlpha = alpha;
+    emit fillAlphaChanged();
+}
 
-    connect(buffer, &CircularBuffer::valuesChanged, this, [this]() {
-        update();
-    });
-    connect(buffer, &QObject::destroyed, this, [this, buffer]() {
-        if (m_line1 == buffer) {
-            m_line1 = nullptr;
-            emit line1Changed();
-        }
-        if (m_line2 == buffer) {
-            m_line2 = nullptr;
-            emit line2Changed();
+bool SparklineSeries::takeReset() {
+    return std::exchange(m_reset, false);
+}
+
+QList<qreal> SparklineSeries::takePending() {
+    return std::exchange(m_pending, {});
+}
+
+SparklineItem::SparklineItem(QQuickItem* parent)
+    : QQuickItem(parent)
+    , m_line1(new SparklineSeries(this))
+    , m_line2(new SparklineSeries(this)) {
+    setFlag(ItemHasContents);
+    // Samples slide in from past the edges
+    setClip(true);
+
+    m_line2->setFillAlpha(0.2);
+
+    connectSeries(m_line1);
+    connectSeries(m_line2);
+    connect(m_line1, &SparklineSeries::bufferChanged, this, &SparklineItem::line1Changed);
+    connect(m_line2, &SparklineSeries::bufferChanged, this, &SparklineItem::line2Changed);
+    connect(m_line1, &SparklineSeries::colorChanged, this, &SparklineItem::line1ColorChanged);
+    connect(m_line2, &SparklineSeries::colorChanged, this, &SparklineItem::line2ColorChanged);
+    connect(m_line1, &SparklineSeries::fillAlphaChanged, this, &SparklineItem::line1FillAlphaChanged);
+    connect(m_line2, &SparklineSeries::fillAlphaChanged, this, &SparklineItem::line2FillAlphaChanged);
+}
+
+QSGNode* SparklineItem::updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData*) {
+    auto* root = oldNode ? oldNode : new QSGNode;
+
+    if (m_seriesDirty) {
+        while (auto* child = root->firstChild()) {
+            root->removeChildNode(child);
+            delete child;
         }
+        for (auto* series : activeSeries())
+            root->appendChildNode(new SparklineSeriesNode(series));
+        m_seriesDirty = false;
+    }
+
+    const qreal stepX = m_historyLength >= 2 ? width() / static_cast<qreal>(m_historyLength - 1) : 0;
+    for (auto* child = root->firstChild(); child; child = child->nextSibling())
+        static_cast<SparklineSeriesNode*>(child)->sync(stepX, m_maxValue, m_slideProgress, m_lineWidth, size());
+
+    return root;
+}
+
+void SparklineItem::geometryChange(const QRectF& newGeometry, const QRectF& oldGeometry) {
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size())
+        update();
+}
+
+void SparklineItem::connectSeries(SparklineSeries* series) {
+    connect(series, &SparklineSeries::dataChanged, this, &QQuickItem::update);
+    connect(series, &SparklineSeries::colorChanged, this, &QQuickItem::update);
+    connect(series, &SparklineSeries::fillAlphaChanged, this, &QQuickItem::update);
+    connect(series, &SparklineSeries::bufferChanged, this, [this]() {
+        m_seriesDirty = true;
         update();
     });
 }
 
+QList<SparklineSeries*> SparklineItem::activeSeries() const {
+    QList<SparklineSeries*> active;
+    for (auto* series : { m_line1, m_line2 })
+        if (series->buffer())
+            active << series;
+    for (auto* series : m_series)
+        if (series->buffer())
+            active << series;
+    return active;
+}
+
+void SparklineItem::appendSeries(QQmlListProperty<SparklineSeries>* list, SparklineSeries* series) {
+    auto* self = static_cast<SparklineItem*>(list->object);
+    if (!series || self->m_series.contains(series))
+        return;
+
+    self->m_series << series;
+    self->connectSeries(series);
+    connect(series, &QObject::destroyed, self, [self, series]() {
+        self->m_series.removeOne(series);
+        self->m_seriesDirty = true;
+        emit self->seriesChanged();
+        self->update();
+    });
+
+    self->m_seriesDirty = true;
+    emit self->seriesChanged();
+    self->update();
+}
+
+qsizetype SparklineItem::seriesCount(QQmlListProperty<SparklineSeries>* list) {
+    return static_cast<SparklineItem*>(list->object)->m_series.size();
+}
+
+SparklineSeries* SparklineItem::seriesAt(QQmlListProperty<SparklineSeries>* list, qsizetype index) {
+    return static_cast<SparklineItem*>(list->object)->m_series.at(index);
+}
+
+void SparklineItem::clearSeries(QQmlListProperty<SparklineSeries>* list) {
+    auto* self = static_cast<SparklineItem*>(list->object);
+    for (auto* series : std::as_const(self->m_series))
+        disconnect(series, nullptr, self, nullptr);
+    self->m_series.clear();
+
+    self->m_seriesDirty = true;
+    emit self->seriesChanged();
+    self->update();
+}
+
 CircularBuffer* SparklineItem::line1() const {
-    return m_line1;
+    return m_line1->buffer();
 }
 
 void SparklineItem::setLine1(CircularBuffer* buffer) {
-    if (m_line1 == buffer)
-        return;
-    if (m_line1)
-        disconnect(m_line1, nullptr, this, nullptr);
-    m_line1 = buffer;
-    connectBuffer(buffer);
-    emit line1Changed();
-    update();
+    m_line1->setBuffer(buffer);
 }
 
 CircularBuffer* SparklineItem::line2() const {
-    return m_line2;
+    return m_line2->buffer();
 }
 
 void SparklineItem::setLine2(CircularBuffer* buffer) {
-    if (m_line2 == buffer)
-        return;
-    if (m_line2)
-        disconnect(m_line2, nullptr, this, nullptr);
-    m_line2 = buffer;
-    connectBuffer(buffer);
-    emit line2Changed();
-    update();
+    m_line2->setBuffer(buffer);
 }
 
 QColor SparklineItem::line1Color() const {
-    return m_line1Color;
+    return m_line1->color();
 }
 
 void SparklineItem::setLine1Color(const QColor& color) {
-    if (m_line1Color == color)
-        return;
-    m_line1Color = color;
-    emit line1ColorChanged();
-    update();
+    m_line1->setColor(color);
 }
 
 QColor SparklineItem::line2Color() const {
-    return m_line2Color;
+    return m_line2->color();
 }
 
 void SparklineItem::setLine2Color(const QColor& color) {
-    if (m_line2Color == color)
-        return;
-    m_line2Color = color;
-    emit line2ColorChanged();
-    update();
+    m_line2->setColor(color);
 }
 
 qreal SparklineItem::line1FillAlpha() const {
-    return m_line1FillAlpha;
+    return m_line1->fillAlpha();
 }
 
 void SparklineItem::setLine1FillAlpha(qreal alpha) {
-    if (qFuzzyCompare(m_line1FillAlpha, alpha))
-        return;
-    m_line1FillAlpha = alpha;
-    emit line1FillAlphaChanged();
-    update();
+    m_line1->setFillAlpha(alpha);
 }
 
 qreal SparklineItem::line2FillAlpha() const {
-    return m_line2FillAlpha;
+    return m_line2->fillAlpha();
 }
 
 void SparklineItem::setLine2FillAlpha(qreal alpha) {
-    if (qFuzzyCompare(m_line2FillAlpha, alpha))
-        return;
-    m_line2FillAlpha = alpha;
-    emit line2FillAlphaChanged();
-    update();
+    m_line2->setFillAlpha(alpha);
+}
+
+QQmlListProperty<SparklineSeries> SparklineItem::series() {
+    return QQmlListProperty<SparklineSeries>(
+        this, nullptr, &SparklineItem::appendSeries, &SparklineItem::seriesCount, &SparklineItem::seriesAt,
+        &SparklineItem::clearSeries);
 }
 
 qreal SparklineItem::maxValue() const {
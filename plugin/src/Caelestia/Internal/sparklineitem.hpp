@@ -1,15 +1,57 @@
 #pragma once
 
 #include <qcolor.h>
+#include <qlist.h>
 #include <qobject.h>
 #include <qqmlintegration.h>
-#include <qquickpainteditem.h>
+#include <qqmllist.h>
+#include <qquickitem.h>
 
 #include "circularbuffer.hpp"
 
 namespace caelestia::internal {
 
-class SparklineItem : public QQuickPaintedItem {
+class SparklineSeries : public QObject {
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(CircularBuffer* buffer READ buffer WRITE setBuffer NOTIFY bufferChanged)
+    Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY colorChanged)
+    Q_PROPERTY(qreal fillAlpha READ fillAlpha WRITE setFillAlpha NOTIFY fillAlphaChanged)
+
+public:
+    explicit SparklineSeries(QObject* parent = nullptr);
+
+    [[nodiscard]] CircularBuffer* buffer() const;
+    void setBuffer(CircularBuffer* buffer);
+
+    [[nodiscard]] QColor color() const;
+    void setColor(const QColor& color);
+
+    [[nodiscard]] qreal fillAlpha() const;
+    void setFillAlpha(qreal alpha);
+
+    // Values pushed since the last sync, or a full rebuild if the buffer was reset. Only called while the
+    // GUI thread is blocked in the scenegraph sync.
+    [[nodiscard]] bool takeReset();
+    [[nodiscard]] QList<qreal> takePending();
+
+signals:
+    void bufferChanged();
+    void colorChanged();
+    void fillAlphaChanged();
+    void dataChanged();
+
+private:
+    CircularBuffer* m_buffer = nullptr;
+    QColor m_color;
+    qreal m_fillAlpha = 0.15;
+
+    QList<qreal> m_pending;
+    bool m_reset = true;
+};
+
+class SparklineItem : public QQuickItem {
     Q_OBJECT
     QML_ELEMENT
 
@@ -19,6 +61,7 @@ class SparklineItem : public QQuickPaintedItem {
     Q_PROPERTY(QColor line2Color READ line2Color WRITE setLine2Color NOTIFY line2ColorChanged)
     Q_PROPERTY(qreal line1FillAlpha READ line1FillAlpha WRITE setLine1FillAlpha NOTIFY line1FillAlphaChanged)
     Q_PROPERTY(qreal line2FillAlpha READ line2FillAlpha WRITE setLine2FillAlpha NOTIFY line2FillAlphaChanged)
+    Q_PROPERTY(QQmlListProperty<caelestia::internal::SparklineSeries> series READ series NOTIFY seriesChanged)
     Q_PROPERTY(qreal maxValue READ maxValue WRITE setMaxValue NOTIFY maxValueChanged)
     Q_PROPERTY(qreal slideProgress READ slideProgress WRITE setSlideProgress NOTIFY slideProgressChanged)
     Q_PROPERTY(int historyLength READ historyLength WRITE setHistoryLength NOTIFY historyLengthChanged)
@@ -27,8 +70,6 @@ class SparklineItem : public QQuickPaintedItem {
 public:
     explicit SparklineItem(QQuickItem* parent = nullptr);
 
-    void paint(QPainter* painter) override;
-
     [[nodiscard]] CircularBuffer* line1() const;
     void setLine1(CircularBuffer* buffer);
 
@@ -47,6 +88,8 @@ public:
     [[nodiscard]] qreal line2FillAlpha() const;
     void setLine2FillAlpha(qreal alpha);
 
+    [[nodiscard]] QQmlListProperty<SparklineSeries> series();
+
     [[nodiscard]] qreal maxValue() const;
     void setMaxValue(qreal value);
 
@@ -66,21 +109,31 @@ signals:
     void line2ColorChanged();
     void line1FillAlphaChanged();
     void line2FillAlphaChanged();
+    void seriesChanged();
     void maxValueChanged();
     void slideProgressChanged();
     void historyLengthChanged();
     void lineWidthChanged();
 
+protected:
+    QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data) override;
+    void geometryChange(const QRectF& newGeometry, const QRectF& oldGeometry) override;
+
 private:
-    void drawLine(QPainter* painter, CircularBuffer* buffer, const QColor& color, qreal fillAlpha);
-    void connectBuffer(CircularBuffer* buffer);
-
-    CircularBuffer* m_line1 = nullptr;
-    CircularBuffer* m_line2 = nullptr;
-    QColor m_line1Color;
-    QColor m_line2Color;
-    qreal m_line1FillAlpha = 0.15;
-    qreal m_line2FillAlpha = 0.2;
+    static void appendSeries(QQmlListProperty<SparklineSeries>* list, SparklineSeries* series);
+    static qsizetype seriesCount(QQmlListProperty<SparklineSeries>* list);
+    static SparklineSeries* seriesAt(QQmlListProperty<SparklineSeries>* list, qsizetype index);
+    static void clearSeries(QQmlListProperty<SparklineSeries>* list);
+
+    void connectSeries(SparklineSeries* series);
+    [[nodiscard]] QList<SparklineSeries*> activeSeries() const;
+
+    // line1 and line2 are kept as built in series drawn below any in the series list
+    SparklineSeries* m_line1;
+    SparklineSeries* m_line2;
+    QList<SparklineSeries*> m_series;
+    bool m_seriesDirty = true;
+
     qreal m_maxValue = 1024.0;
     qreal m_slideProgress = 0.0;
     int m_historyLength = 30;
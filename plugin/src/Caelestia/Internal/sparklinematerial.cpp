@@ -0,0 +1,82 @@
+#include "sparklinematerial.hpp"
+
+#include <cstring>
+
+namespace caelestia::internal {
+
+const QSGGeometry::AttributeSet& sparklineAttributes() {
+    static const QSGGeometry::Attribute attributes[] = {
+        QSGGeometry::Attribute::createWithAttributeType(0, 2, QSGGeometry::FloatType, QSGGeometry::PositionAttribute),
+        QSGGeometry::Attribute::createWithAttributeType(1, 2, QSGGeometry::FloatType, QSGGeometry::UnknownAttribute),
+        QSGGeometry::Attribute::createWithAttributeType(2, 2, QSGGeometry::FloatType, QSGGeometry::UnknownAttribute),
+        QSGGeometry::Attribute::createWithAttributeType(3, 1, QSGGeometry::FloatType, QSGGeometry::UnknownAttribute),
+    };
+    static const QSGGeometry::AttributeSet set = { 4, sizeof(SparklineVertex), attributes };
+    return set;
+}
+
+SparklineMaterial::SparklineMaterial() {
+    // Vertices are in sample space, so they can't be pre-transformed into a merged batch
+    setFlag(Blending | RequiresFullMatrix);
+}
+
+QSGMaterialType* SparklineMaterial::type() const {
+    static QSGMaterialType s_type;
+    return &s_type;
+}
+
+QSGMaterialShader* SparklineMaterial::createShader(QSGRendererInterface::RenderMode) const {
+    return new SparklineMaterialShader;
+}
+
+int SparklineMaterial::compare(const QSGMaterial* other) const {
+    if (this < other)
+        return -1;
+    if (this > other)
+        return 1;
+    return 0;
+}
+
+SparklineMaterialShader::SparklineMaterialShader() {
+    setShaderFileName(VertexStage, QStringLiteral(":/shaders/sparkline.vert.qsb"));
+    setShaderFileName(FragmentStage, QStringLiteral(":/shaders/sparkline.frag.qsb"));
+}
+
+bool SparklineMaterialShader::updateUniformData(RenderState& state, QSGMaterial* newMaterial, QSGMaterial* oldMaterial) {
+    Q_UNUSED(oldMaterial);
+    auto* mat = static_cast<SparklineMaterial*>(newMaterial);
+    QByteArray* buf = state.uniformData();
+    Q_ASSERT(buf->size() >= 112);
+
+    if (state.isMatrixDirty()) {
+        const QMatrix4x4 m = state.combinedMatrix();
+        memcpy(buf->data(), m.constData(), 64);
+    }
+    if (state.isOpacityDirty()) {
+        const float opacity = state.opacity();
+        memcpy(buf->data() + 64, &opacity, 4);
+    }
+
+    // Scroll, step and max value (offset 68)
+    memcpy(buf->data() + 68, &mat->m_scroll, 4);
+    memcpy(buf->data() + 72, &mat->m_stepX, 4);
+    memcpy(buf->data() + 76, &mat->m_maxValue, 4);
+
+    // Size as vec2 (offset 80) and half line width (offset 88)
+    memcpy(buf->data() + 80, &mat->m_width, 4);
+    memcpy(buf->data() + 84, &mat->m_height, 4);
+    memcpy(buf->data() + 88, &mat->m_halfWidth, 4);
+
+    // Color as vec4 (offset 96, 16 bytes)
+    const float color[4] = {
+        static_cast<float>(mat->m_color.redF()),
+        static_cast<float>(mat->m_color.greenF()),
+        static_cast<float>(mat->m_color.blueF()),
+        static_cast<float>(mat->m_color.alphaF()),
+    };
+    memcpy(buf->data() + 96, color, 16);
+
+    return true;
+}
+
+} // namespace caelestia::internal
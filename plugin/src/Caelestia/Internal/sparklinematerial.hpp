@@ -0,0 +1,44 @@
+#pragma once
+
+#include <qcolor.h>
+#include <qsggeometry.h>
+#include <qsgmaterial.h>
+#include <qsgmaterialshader.h>
+
+namespace caelestia::internal {
+
+struct SparklineVertex {
+    // Sample ordinal and value, mapped to item space in the vertex shader
+    float x, y;
+    float prevX, prevY;
+    float nextX, nextY;
+    // -1 or 1 for the two sides of a line, 0 for fill vertices
+    float side;
+};
+
+const QSGGeometry::AttributeSet& sparklineAttributes();
+
+class SparklineMaterial : public QSGMaterial {
+public:
+    SparklineMaterial();
+
+    QSGMaterialType* type() const override;
+    QSGMaterialShader* createShader(QSGRendererInterface::RenderMode) const override;
+    int compare(const QSGMaterial* other) const override;
+
+    float m_scroll = 0;
+    float m_stepX = 0;
+    float m_maxValue = 1;
+    float m_width = 0;
+    float m_height = 0;
+    float m_halfWidth = 1;
+    QColor m_color;
+};
+
+class SparklineMaterialShader : public QSGMaterialShader {
+public:
+    SparklineMaterialShader();
+    bool updateUniformData(RenderState& state, QSGMaterial* newMaterial, QSGMaterial* oldMaterial) override;
+};
+
+} // namespace caelestia::internal
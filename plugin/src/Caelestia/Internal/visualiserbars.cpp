@@ -1,17 +1,15 @@
 #include "visualiserbars.hpp"
 
+#include "visualiserbarsmaterial.hpp"
 #include <algorithm>
 #include <cmath>
-#include <qbrush.h>
-#include <qpainter.h>
-#include <qpainterpath.h>
-#include <qpen.h>
+#include <qsgnode.h>
 
 namespace caelestia::internal {
 
 VisualiserBars::VisualiserBars(QQuickItem* parent)
-    : QQuickPaintedItem(parent) {
-    setAntialiasing(true);
+    : QQuickItem(parent) {
+    setFlag(ItemHasContents, true);
 }
 
 void VisualiserBars::advance(qreal dt) {
@@ -44,73 +42,97 @@ void VisualiserBars::advance(qreal dt) {
     }
 }
 
-void VisualiserBars::paint(QPainter* painter) {
-    if (m_displayValues.isEmpty())
-        return;
-
-    painter->setRenderHint(QPainter::Antialiasing, true);
-    painter->setPen(Qt::NoPen);
-
-    const qreal h = height();
-    const qreal maxBarHeight = h * 0.4;
-
-    QLinearGradient gradient(0, h - maxBarHeight, 0, h);
-    gradient.setColorAt(0, m_primaryColor);
-    gradient.setColorAt(1, m_secondaryColor);
-    painter->setBrush(gradient);
-
-    drawSide(painter, false);
-    drawSide(painter, true);
-}
-
-void VisualiserBars::drawSide(QPainter* painter, bool rightSide) {
+QSGNode* VisualiserBars::updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData*) {
+    const auto count = m_displayValues.size();
     const qreal w = width();
     const qreal h = height();
-    const auto count = m_displayValues.size();
-
-    if (count == 0)
-        return;
 
     const qreal sideWidth = w * 0.4;
-    const qreal slotWidth = sideWidth / static_cast<qreal>(count);
+    const qreal slotWidth = count > 0 ? sideWidth / static_cast<qreal>(count) : 0;
     const qreal barWidth = slotWidth - m_spacing;
 
-    if (barWidth <= 0)
-        return;
-
-    const qreal sideOffset = rightSide ? w * 0.6 : 0;
-    const qreal maxBarHeight = h * 0.4;
+    if (count == 0 || barWidth <= 0 || h <= 0) {
+        delete oldNode;
+        return nullptr;
+    }
 
-    for (qsizetype i = 0; i < count; ++i) {
-        const qsizetype valueIndex = rightSide ? i : (count - i - 1);
-        const qreal value = std::clamp(m_displayValues[valueIndex], 0.0, 1.0);
-        const qreal barHeight = value * maxBarHeight;
+    auto* node = static_cast<QSGGeometryNode*>(oldNode);
+    if (!node) {
+        node = new QSGGeometryNode;
 
-        if (barHeight <= 0)
-            continue;
+        auto* geometry = new QSGGeometry(visualiserBarAttributes(), 0, 0);
+        geometry->setDrawingMode(QSGGeometry::DrawTriangles);
+        node->setGeometry(geometry);
+        node->setFlag(QSGNode::OwnsGeometry);
 
-        const qreal x = static_cast<qreal>(i) * slotWidth + sideOffset;
-        const qreal y = h - barHeight;
-        const qreal r = std::min({ m_rounding, barWidth / 2.0, barHeight });
+        auto* material = new VisualiserBarsMaterial;
+        material->setFlag(QSGMaterial::Blending);
+        node->setMaterial(material);
+        node->setFlag(QSGNode::OwnsMaterial);
+    }
 
-        QPainterPath path;
-        path.moveTo(x, h);
-        path.lineTo(x, y + r);
+    // One quad per bar on each side, indices only change with the bar count
+    auto* geometry = node->geometry();
+    const int bars = static_cast<int>(count) * 2;
+    if (geometry->vertexCount() != bars * 4) {
+        geometry->allocate(bars * 4, bars * 6);
+
+        constexpr int quad[6] = { 0, 1, 2, 2, 1, 3 };
+        auto* indices = geometry->indexDataAsUShort();
+        for (int i = 0; i < bars; ++i) {
+            for (int j = 0; j < 6; ++j)
+                indices[i * 6 + j] = static_cast<quint16>(i * 4 + quad[j]);
+        }
+    }
 
-        if (r > 0) {
-            path.arcTo(x, y, r * 2, r * 2, 180, -90);
-            path.lineTo(x + barWidth - r, y);
-            path.arcTo(x + barWidth - r * 2, y, r * 2, r * 2, 90, -90);
-        } else {
-            path.lineTo(x, y);
-            path.lineTo(x + barWidth, y);
+    const qreal maxBarHeight = h * 0.4;
+    auto* v = static_cast<VisualiserBarVertex*>(geometry->vertexData());
+
+    for (int side = 0; side < 2; ++side) {
+        const bool rightSide = side == 1;
+        const qreal sideOffset = rightSide ? w * 0.6 : 0;
+
+        for (qsizetype i = 0; i < count; ++i) {
+            const qsizetype valueIndex = rightSide ? i : (count - i - 1);
+            const qreal value = std::clamp(m_displayValues[valueIndex], 0.0, 1.0);
+            const qreal barHeight = value * maxBarHeight;
+
+            const auto x0 = static_cast<float>(static_cast<qreal>(i) * slotWidth + sideOffset);
+            const auto x1 = x0 + static_cast<float>(barWidth);
+            const auto y0 = static_cast<float>(h - barHeight);
+            const auto y1 = static_cast<float>(h);
+
+            const auto bw = static_cast<float>(barWidth);
+            const auto bh = static_cast<float>(barHeight);
+            const auto r = static_cast<float>(std::min({ m_rounding, barWidth / 2.0, barHeight }));
+
+            // Gradient spans the maximum bar height, from the top (0) to the bottom (1)
+            const auto t = static_cast<float>(1.0 - value);
+
+            v[0].set(x0, y0, 0.0f, 0.0f, t, bw, bh, r);
+            v[1].set(x1, y0, bw, 0.0f, t, bw, bh, r);
+            v[2].set(x0, y1, 0.0f, bh, 1.0f, bw, bh, r);
+            v[3].set(x1, y1, bw, bh, 1.0f, bw, bh, r);
+            v += 4;
         }
+    }
 
-        path.lineTo(x + barWidth, h);
-        path.closeSubpath();
+    node->markDirty(QSGNode::DirtyGeometry);
 
-        painter->drawPath(path);
+    auto* material = static_cast<VisualiserBarsMaterial*>(node->material());
+    if (material->m_primaryColor != m_primaryColor || material->m_secondaryColor != m_secondaryColor) {
+        material->m_primaryColor = m_primaryColor;
+        material->m_secondaryColor = m_secondaryColor;
+        node->markDirty(QSGNode::DirtyMaterial);
     }
+
+    return node;
+}
+
+void VisualiserBars::geometryChange(const QRectF& newGeometry, const QRectF& oldGeometry) {
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size())
+        update();
 }
 
 QVector<double> VisualiserBars::values() const {
@@ -118,7 +140,11 @@ QVector<double> VisualiserBars::values() const {
 }
 
 void VisualiserBars::setValues(const QVector<double>& values) {
-    m_targetValues = values;
+    // Copy into our own storage rather than sharing, so the provider can keep writing into its buffers in place
+    if (m_targetValues.size() == values.size() && m_targetValues.isDetached())
+        std::copy(values.cbegin(), values.cend(), m_targetValues.begin());
+    else
+        m_targetValues = QVector<double>(values.cbegin(), values.cend());
 
     if (m_displayValues.size() != values.size()) {
         m_displayValues.resize(values.size(), 0.0);
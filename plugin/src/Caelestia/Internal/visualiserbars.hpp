@@ -3,12 +3,12 @@
 #include <qcolor.h>
 #include <qobject.h>
 #include <qqmlintegration.h>
-#include <qquickpainteditem.h>
+#include <qquickitem.h>
 #include <qvector.h>
 
 namespace caelestia::internal {
 
-class VisualiserBars : public QQuickPaintedItem {
+class VisualiserBars : public QQuickItem {
     Q_OBJECT
     QML_ELEMENT
 
@@ -23,8 +23,6 @@ class VisualiserBars : public QQuickPaintedItem {
 public:
     explicit VisualiserBars(QQuickItem* parent = nullptr);
 
-    void paint(QPainter* painter) override;
-
     Q_INVOKABLE void advance(qreal dt);
 
     [[nodiscard]] QVector<double> values() const;
@@ -56,9 +54,11 @@ signals:
     void animationDurationChanged();
     void settledChanged();
 
-private:
-    void drawSide(QPainter* painter, bool rightSide);
+protected:
+    QSGNode* updatePaintNode(QSGNode* oldNode, UpdatePaintNodeData* data) override;
+    void geometryChange(const QRectF& newGeometry, const QRectF& oldGeometry) override;
 
+private:
     QVector<double> m_targetValues;
     QVector<double> m_displayValues;
     QColor m_primaryColor;
@@ -0,0 +1,88 @@
+#include "visualiserbarsmaterial.hpp"
+
+#include <cstring>
+
+namespace caelestia::internal {
+
+namespace {
+
+void writeColor(QByteArray* buf, int offset, const QColor& color) {
+    const float c[4] = {
+        static_cast<float>(color.redF()),
+        static_cast<float>(color.greenF()),
+        static_cast<float>(color.blueF()),
+        static_cast<float>(color.alphaF()),
+    };
+    memcpy(buf->data() + offset, c, 16);
+}
+
+} // namespace
+
+void VisualiserBarVertex::set(float nx, float ny, float nu, float nv, float nt, float nw, float nh, float nr) {
+    x = nx;
+    y = ny;
+    u = nu;
+    v = nv;
+    t = nt;
+    w = nw;
+    h = nh;
+    r = nr;
+}
+
+const QSGGeometry::AttributeSet& visualiserBarAttributes() {
+    static const QSGGeometry::Attribute attributes[] = {
+        QSGGeometry::Attribute::createWithAttributeType(0, 2, QSGGeometry::FloatType, QSGGeometry::PositionAttribute),
+        QSGGeometry::Attribute::createWithAttributeType(1, 3, QSGGeometry::FloatType, QSGGeometry::TexCoordAttribute),
+        QSGGeometry::Attribute::createWithAttributeType(2, 3, QSGGeometry::FloatType, QSGGeometry::UnknownAttribute),
+    };
+    static const QSGGeometry::AttributeSet set = { 3, sizeof(VisualiserBarVertex), attributes };
+    return set;
+}
+
+QSGMaterialType* VisualiserBarsMaterial::type() const {
+    static QSGMaterialType s_type;
+    return &s_type;
+}
+
+QSGMaterialShader* VisualiserBarsMaterial::createShader(QSGRendererInterface::RenderMode) const {
+    return new VisualiserBarsMaterialShader;
+}
+
+int VisualiserBarsMaterial::compare(const QSGMaterial* other) const {
+    const auto* o = static_cast<const VisualiserBarsMaterial*>(other);
+    if (m_primaryColor != o->m_primaryColor)
+        return m_primaryColor.rgba() < o->m_primaryColor.rgba() ? -1 : 1;
+    if (m_secondaryColor != o->m_secondaryColor)
+        return m_secondaryColor.rgba() < o->m_secondaryColor.rgba() ? -1 : 1;
+    return 0;
+}
+
+VisualiserBarsMaterialShader::VisualiserBarsMaterialShader() {
+    setShaderFileName(VertexStage, QStringLiteral(":/shaders/visualiserbars.vert.qsb"));
+    setShaderFileName(FragmentStage, QStringLiteral(":/shaders/visualiserbars.frag.qsb"));
+}
+
+bool VisualiserBarsMaterialShader::updateUniformData(
+    RenderState& state, QSGMaterial* newMaterial, QSGMaterial* oldMaterial) {
+    Q_UNUSED(oldMaterial);
+    auto* mat = static_cast<VisualiserBarsMaterial*>(newMaterial);
+    QByteArray* buf = state.uniformData();
+    Q_ASSERT(buf->size() >= 112);
+
+    if (state.isMatrixDirty()) {
+        const QMatrix4x4 m = state.combinedMatrix();
+        memcpy(buf->data(), m.constData(), 64);
+    }
+    if (state.isOpacityDirty()) {
+        const float opacity = state.opacity();
+        memcpy(buf->data() + 64, &opacity, 4);
+    }
+
+    // Gradient colours (offset 80 and 96, 16 bytes each)
+    writeColor(buf, 80, mat->m_primaryColor);
+    writeColor(buf, 96, mat->m_secondaryColor);
+
+    return true;
+}
+
+} // namespace caelestia::internal
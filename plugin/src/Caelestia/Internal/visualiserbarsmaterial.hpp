@@ -0,0 +1,38 @@
+#pragma once
+
+#include <qcolor.h>
+#include <qsggeometry.h>
+#include <qsgmaterial.h>
+#include <qsgmaterialshader.h>
+
+namespace caelestia::internal {
+
+struct VisualiserBarVertex {
+    float x, y;
+    // Position inside the bar from its top left corner, and gradient position
+    float u, v, t;
+    // Bar width, height and top corner radius
+    float w, h, r;
+
+    void set(float nx, float ny, float nu, float nv, float nt, float nw, float nh, float nr);
+};
+
+const QSGGeometry::AttributeSet& visualiserBarAttributes();
+
+class VisualiserBarsMaterial : public QSGMaterial {
+public:
+    QSGMaterialType* type() const override;
+    QSGMaterialShader* createShader(QSGRendererInterface::RenderMode) const override;
+    int compare(const QSGMaterial* other) const override;
+
+    QColor m_primaryColor;
+    QColor m_secondaryColor;
+};
+
+class VisualiserBarsMaterialShader : public QSGMaterialShader {
+public:
+    VisualiserBarsMaterialShader();
+    bool updateUniformData(RenderState& state, QSGMaterial* newMaterial, QSGMaterial* oldMaterial) override;
+};
+
+} // namespace caelestia::internal
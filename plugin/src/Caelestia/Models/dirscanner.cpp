@@ -0,0 +1,357 @@
+#include "dirscanner.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <deque>
+#include <dirent.h>
+#include <fcntl.h>
+#include <qdir.h>
+#include <qelapsedtimer.h>
+#include <qfile.h>
+#include <qfuture.h>
+#include <qmutex.h>
+#include <qregularexpression.h>
+#include <qtconcurrentrun.h>
+#include <qthread.h>
+#include <qthreadpool.h>
+#include <qwaitcondition.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace caelestia::models {
+
+namespace {
+
+constexpr size_t DENTS_BUFFER_SIZE = 32768;
+constexpr qsizetype BATCH_SIZE = 256;
+constexpr qint64 BATCH_INTERVAL = 50; // ms
+constexpr int MAX_WORKERS = 8;
+constexpr unsigned long IDLE_WAIT = 20; // ms, idle workers wake at least this often to check for cancellation
+
+// Fixed part of a linux_dirent64 record, the null terminated name follows the type
+struct DirentHeader {
+    quint64 ino;
+    qint64 off;
+    unsigned short reclen;
+    unsigned char type;
+};
+constexpr size_t DIRENT_NAME_OFFSET = offsetof(DirentHeader, type) + 1;
+
+void setStat(DirScanner::Entry& entry, const struct stat& st) {
+    entry.size = st.st_size;
+    entry.mtime = st.st_mtim.tv_sec * 1'000'000'000 + st.st_mtim.tv_nsec;
+}
+
+// The name, type and content checks shared by walks and single lookups
+class EntryFilter {
+public:
+    explicit EntryFilter(const DirScanner::Options& options)
+        : m_options(options) {
+        for (const auto& filter : options.nameFilters) {
+            m_nameFilters << QRegularExpression(QRegularExpression::wildcardToRegularExpression(filter),
+                QRegularExpression::CaseInsensitiveOption);
+        }
+    }
+
+    [[nodiscard]] bool skipName(const char* name) const {
+        if (name[0] != '.') {
+            return false;
+        }
+        return name[1] == '\0' || (name[1] == '.' && name[2] == '\0') || !m_options.showHidden;
+    }
+
+    // Appends the entry to out if it passes everything, returns whether it did
+    bool add(const QByteArray& path, const char* name, bool isDir, bool isFile, QList<DirScanner::Entry>& out) const {
+        if (isDir ? !m_options.dirs : !(isFile && m_options.files)) {
+            return false;
+        }
+
+        if (!m_nameFilters.isEmpty()) {
+            const auto fileName = QFile::decodeName(name);
+            const bool matches = std::any_of(m_nameFilters.cbegin(), m_nameFilters.cend(), [&fileName](const auto& re) {
+                return re.match(fileName).hasMatch();
+            });
+            if (!matches) {
+                return false;
+            }
+        }
+
+        auto decoded = QFile::decodeName(path);
+        if (isFile && m_options.accept && !m_options.accept(decoded)) {
+            return false;
+        }
+
+        out << DirScanner::Entry{ std::move(decoded), 0, 0, isDir };
+        return true;
+    }
+
+private:
+    const DirScanner::Options& m_options;
+    QList<QRegularExpression> m_nameFilters;
+};
+
+struct Queue {
+    QMutex mutex;
+    std::deque<QByteArray> dirs;
+};
+
+// Helpers get a pool of their own so big walks can't starve everything else using the global pool
+QThreadPool* helperPool() {
+    static QThreadPool* pool = []() {
+        auto* p = new QThreadPool;
+        p->setMaxThreadCount(MAX_WORKERS - 1);
+        return p;
+    }();
+    return pool;
+}
+
+class Walk {
+public:
+    Walk(const DirScanner::Options& options, const DirScanner::BatchHandler& handler,
+        const DirScanner::CancelCheck& cancelled, int workers)
+        : m_options(options)
+        , m_filter(options)
+        , m_handler(handler)
+        , m_cancelled(cancelled)
+        , m_queues(static_cast<size_t>(workers))
+        , m_pending(0)
+        , m_queued(0)
+        , m_delivered(false) {}
+
+    void push(size_t worker, QByteArray dir) {
+        ++m_pending;
+        {
+            auto& queue = m_queues[worker];
+            QMutexLocker locker(&queue.mutex);
+            queue.dirs.push_back(std::move(dir));
+        }
+        ++m_queued;
+
+        QMutexLocker locker(&m_idleMutex);
+        m_idle.wakeOne();
+    }
+
+    void run(size_t worker) {
+        QList<DirScanner::Entry> batch;
+        QElapsedTimer timer;
+        timer.start();
+        std::vector<char> buffer(DENTS_BUFFER_SIZE);
+
+        while (!m_cancelled()) {
+            QByteArray dir;
+            if (take(worker, dir)) {
+                read(worker, dir, buffer, batch, timer);
+                if (--m_pending == 0) {
+                    QMutexLocker locker(&m_idleMutex);
+                    m_idle.wakeAll();
+                }
+            } else if (m_pending == 0) {
+                break;
+            } else {
+                // Another worker is still reading a directory which may have subdirectories to share, sleep until it
+                // queues one or the walk ends
+                QMutexLocker locker(&m_idleMutex);
+                if (m_queued == 0 && m_pending != 0) {
+                    m_idle.wait(&m_idleMutex, IDLE_WAIT);
+                }
+            }
+        }
+
+        if (!m_cancelled()) {
+            flush(batch, timer);
+        }
+    }
+
+private:
+    const DirScanner::Options& m_options;
+    const EntryFilter m_filter;
+    const DirScanner::BatchHandler& m_handler;
+    const DirScanner::CancelCheck& m_cancelled;
+
+    std::vector<Queue> m_queues;
+    std::atomic<int> m_pending; // directories queued or being read
+    std::atomic<int> m_queued;  // directories queued
+    std::atomic<bool> m_delivered;
+    QMutex m_handlerMutex;
+    QMutex m_idleMutex;
+    QWaitCondition m_idle;
+
+    bool take(size_t worker, QByteArray& dir) {
+        // Own work from the back to stay depth first, stolen work from the front where the biggest subtrees are
+        {
+            auto& own = m_queues[worker];
+            QMutexLocker locker(&own.mutex);
+            if (!own.dirs.empty()) {
+                dir = std::move(own.dirs.back());
+                own.dirs.pop_back();
+                --m_queued;
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < m_queues.size(); ++i) {
+            auto& other = m_queues[(worker + i) % m_queues.size()];
+            QMutexLocker locker(&other.mutex);
+            if (!other.dirs.empty()) {
+                dir = std::move(other.dirs.front());
+                other.dirs.pop_front();
+                --m_queued;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void read(size_t worker, const QByteArray& dir, std::vector<char>& buffer, QList<DirScanner::Entry>& batch,
+        QElapsedTimer& timer) {
+        const int fd = open(dir.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        for (;;) {
+            const long n = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+
+            for (long pos = 0; pos < n;) {
+                const auto* header = reinterpret_cast<const DirentHeader*>(buffer.data() + pos);
+                addEntry(worker, fd, dir, buffer.data() + pos + DIRENT_NAME_OFFSET, header->type, batch);
+                pos += header->reclen;
+            }
+
+            if (m_cancelled()) {
+                break;
+            }
+            if (batch.size() >= BATCH_SIZE) {
+                flush(batch, timer);
+            }
+        }
+
+        close(fd);
+
+        // Get something on screen as soon as possible, then settle into fewer, bigger batches
+        if (!m_delivered || timer.elapsed() >= BATCH_INTERVAL) {
+            flush(batch, timer);
+        }
+    }
+
+    void addEntry(size_t worker, int dirFd, const QByteArray& dir, const char* name, unsigned char type,
+        QList<DirScanner::Entry>& batch) {
+        if (m_filter.skipName(name)) {
+            return;
+        }
+
+        bool isDir = type == DT_DIR;
+        bool isFile = type == DT_REG;
+        bool isLink = type == DT_LNK;
+        bool statted = type == DT_UNKNOWN || isLink;
+
+        struct stat st;
+        if (type == DT_UNKNOWN) {
+            if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                return;
+            }
+            isDir = S_ISDIR(st.st_mode);
+            isFile = S_ISREG(st.st_mode);
+            isLink = S_ISLNK(st.st_mode);
+        }
+        if (isLink) {
+            // Links count as whatever they point to, but are never followed when recursing
+            if (fstatat(dirFd, name, &st, 0) != 0) {
+                return;
+            }
+            isDir = S_ISDIR(st.st_mode);
+            isFile = S_ISREG(st.st_mode);
+        }
+
+        QByteArray path = dir;
+        if (!path.endsWith('/')) {
+            path += '/';
+        }
+        path += name;
+
+        if (isDir && !isLink && m_options.recursive) {
+            push(worker, path);
+        }
+
+        // Only what made it through the filters is worth a stat for its size and mtime
+        if (m_filter.add(path, name, isDir, isFile, batch) && (statted || fstatat(dirFd, name, &st, 0) == 0)) {
+            setStat(batch.last(), st);
+        }
+    }
+
+    void flush(QList<DirScanner::Entry>& batch, QElapsedTimer& timer) {
+        if (batch.isEmpty()) {
+            return;
+        }
+
+        {
+            QMutexLocker locker(&m_handlerMutex);
+            m_handler(std::move(batch));
+        }
+
+        batch = {};
+        m_delivered = true;
+        timer.restart();
+    }
+};
+
+} // namespace
+
+void DirScanner::scan(
+    const QString& root, const Options& options, const BatchHandler& handler, const CancelCheck& cancelled) {
+    const int workers = options.recursive ? std::clamp(QThread::idealThreadCount(), 1, MAX_WORKERS) : 1;
+
+    Walk walk(options, handler, cancelled, workers);
+    walk.push(0, QFile::encodeName(QDir::cleanPath(root)));
+
+    // This thread is the first worker. Helpers that never got a pool thread are run inline by waitForFinished, find
+    // nothing left and return.
+    QList<QFuture<void>> helpers;
+    for (int i = 1; i < workers; ++i) {
+        helpers << QtConcurrent::run(helperPool(), [&walk, i]() {
+            walk.run(static_cast<size_t>(i));
+        });
+    }
+
+    walk.run(0);
+
+    for (auto& helper : helpers) {
+        helper.waitForFinished();
+    }
+}
+
+QList<DirScanner::Entry> DirScanner::classify(const QStringList& paths, const Options& options) {
+    const EntryFilter filter(options);
+
+    QList<Entry> entries;
+    for (const auto& path : paths) {
+        const auto encoded = QFile::encodeName(path);
+        const auto slash = encoded.lastIndexOf('/');
+        const char* name = encoded.constData() + slash + 1;
+        if (filter.skipName(name)) {
+            continue;
+        }
+
+        struct stat st;
+        if (stat(encoded.constData(), &st) != 0) {
+            continue;
+        }
+        if (filter.add(encoded, name, S_ISDIR(st.st_mode), S_ISREG(st.st_mode), entries)) {
+            setStat(entries.last(), st);
+        }
+    }
+    return entries;
+}
+
+} // namespace caelestia::models
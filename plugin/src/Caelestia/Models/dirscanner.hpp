@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+#include <qlist.h>
+#include <qstring.h>
+#include <qstringlist.h>
+
+namespace caelestia::models {
+
+// Walks a directory tree with raw getdents64 reads, spreading subdirectories over a few pool threads which steal
+// queued work from each other when idle. Entries are handed out in batches as they are found.
+class DirScanner {
+public:
+    struct Entry {
+        QString path;
+        qint64 size;
+        qint64 mtime; // ns since the epoch
+        bool isDir;
+    };
+
+    struct Options {
+        bool recursive = false;
+        bool showHidden = false;
+        bool files = true;
+        bool dirs = true;
+        QStringList nameFilters;                    // wildcards matched case insensitively against the name
+        std::function<bool(const QString&)> accept; // extra check for files that pass the name filters
+    };
+
+    using BatchHandler = std::function<void(QList<Entry>&&)>;
+    using CancelCheck = std::function<bool()>;
+
+    // Blocks until the tree has been walked or cancelled returns true. The handler is called from the worker
+    // threads, but never by more than one at a time.
+    static void scan(
+        const QString& root, const Options& options, const BatchHandler& handler, const CancelCheck& cancelled);
+
+    // Runs single paths through the same checks as a scan, dropping the ones that would have been skipped
+    [[nodiscard]] static QList<Entry> classify(const QStringList& paths, const Options& options);
+};
+
+} // namespace caelestia::models
@@ -0,0 +1,257 @@
+#include "dirwatcher.hpp"
+
+#include "dirscanner.hpp"
+#include <cerrno>
+#include <cstring>
+#include <qdir.h>
+#include <qfile.h>
+#include <qloggingcategory.h>
+#include <qtconcurrentrun.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+Q_LOGGING_CATEGORY(lcDirWatcher, "caelestia.models.dirwatcher", QtInfoMsg)
+
+namespace caelestia::models {
+
+namespace {
+
+constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+                                IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+constexpr int FLUSH_DELAY = 100; // ms
+constexpr size_t EVENT_BUFFER_SIZE = 16384;
+
+} // namespace
+
+DirWatcher::DirWatcher(QObject* parent)
+    : QObject(parent)
+    , m_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+    , m_notifier(nullptr)
+    , m_recursive(false)
+    , m_showHidden(false)
+    , m_generation(0) {
+    if (m_fd < 0) {
+        qCWarning(lcDirWatcher) << "DirWatcher: failed to create inotify instance:" << strerror(errno);
+    } else {
+        m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, &DirWatcher::readEvents);
+    }
+
+    // Started by the first event of a burst and not restarted by the rest, so a steady stream still gets reported
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FLUSH_DELAY);
+    connect(&m_flushTimer, &QTimer::timeout, this, &DirWatcher::flush);
+}
+
+DirWatcher::~DirWatcher() {
+    delete m_notifier;
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+void DirWatcher::setRoot(const QString& path, bool recursive, bool showHidden) {
+    ++m_generation;
+    clearWatches();
+
+    m_flushTimer.stop();
+    m_pending.clear();
+    m_removedDirs.clear();
+    m_createdDirs.clear();
+
+    m_root = path.isEmpty() ? QString() : QDir::cleanPath(path);
+    m_recursive = recursive;
+    m_showHidden = showHidden;
+
+    if (m_fd >= 0 && !m_root.isEmpty()) {
+        addWatches(m_root);
+    }
+}
+
+bool DirWatcher::addWatch(const QString& path, bool follow) {
+    if (m_watches.contains(path)) {
+        return true;
+    }
+
+    const uint32_t mask = follow ? WATCH_MASK : WATCH_MASK | IN_DONT_FOLLOW;
+    const int wd = inotify_add_watch(m_fd, QFile::encodeName(path).constData(), mask);
+    if (wd < 0) {
+        return false;
+    }
+
+    m_dirs.insert(wd, path);
+    m_watches.insert(path, wd);
+    return true;
+}
+
+void DirWatcher::addWatches(const QString& path) {
+    // The root may well be a link to somewhere else, links found below it are skipped like the scanner's walk does
+    if (!addWatch(path, path == m_root)) {
+        qCWarning(lcDirWatcher) << "addWatches: failed to watch" << path << "-" << strerror(errno);
+        return;
+    }
+
+    if (!m_recursive) {
+        return;
+    }
+
+    const auto generation = m_generation;
+    const bool showHidden = m_showHidden;
+    QtConcurrent::run([path, showHidden]() {
+        DirScanner::Options options;
+        options.recursive = true;
+        options.showHidden = showHidden;
+        options.files = false;
+
+        QStringList dirs;
+        DirScanner::scan(
+            path, options,
+            [&dirs](QList<DirScanner::Entry>&& batch) {
+                for (const auto& entry : batch) {
+                    dirs << entry.path;
+                }
+            },
+            []() {
+                return false;
+            });
+        return dirs;
+    }).then(this, [generation, this](const QStringList& dirs) {
+        if (generation != m_generation) {
+            return;
+        }
+
+        // Links to dirs are refused by IN_DONT_FOLLOW and dirs may be gone already, only running out matters
+        int missed = 0;
+        for (const auto& dir : dirs) {
+            if (!addWatch(dir) && errno == ENOSPC) {
+                ++missed;
+            }
+        }
+        if (missed > 0) {
+            qCWarning(lcDirWatcher) << "addWatches: hit the inotify watch limit, changes in" << missed
+                                    << "dirs will be missed (see fs.inotify.max_user_watches)";
+        }
+    });
+}
+
+void DirWatcher::removeWatches(const QString& path) {
+    const auto prefix = path + '/';
+    for (auto it = m_watches.begin(); it != m_watches.end();) {
+        if (it.key() == path || it.key().startsWith(prefix)) {
+            inotify_rm_watch(m_fd, it.value());
+            m_dirs.remove(it.value());
+            it = m_watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void DirWatcher::clearWatches() {
+    for (auto it = m_dirs.cbegin(); it != m_dirs.cend(); ++it) {
+        inotify_rm_watch(m_fd, it.key());
+    }
+    m_dirs.clear();
+    m_watches.clear();
+}
+
+void DirWatcher::readEvents() {
+    alignas(inotify_event) char buffer[EVENT_BUFFER_SIZE];
+    bool overflow = false;
+
+    for (;;) {
+        const ssize_t n = read(m_fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+
+        for (ssize_t pos = 0; pos < n;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + pos);
+            pos += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED) {
+                const auto path = m_dirs.take(event->wd);
+                if (m_watches.value(path, -1) == event->wd) {
+                    m_watches.remove(path);
+                }
+                continue;
+            }
+
+            // Events can still be queued for watches that have since been removed
+            const auto dir = m_dirs.value(event->wd);
+            if (dir.isNull()) {
+                continue;
+            }
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // Everything else is reported by its parent, only the root has nobody above it
+                if (dir == m_root) {
+                    m_removedDirs << dir;
+                    removeWatches(dir);
+                }
+                continue;
+            }
+
+            if (event->len == 0 || (event->name[0] == '.' && !m_showHidden)) {
+                continue;
+            }
+
+            const auto path = (dir.endsWith('/') ? dir : dir + '/') + QFile::decodeName(event->name);
+            const bool isDir = event->mask & IN_ISDIR;
+
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                m_pending.insert(path, false);
+                if (isDir) {
+                    m_removedDirs << path;
+                    m_createdDirs.remove(path);
+                    removeWatches(path);
+                }
+            } else if (event->mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE)) {
+                m_pending.insert(path, true);
+                if (isDir && m_recursive) {
+                    m_createdDirs << path;
+                    addWatches(path);
+                }
+            }
+        }
+    }
+
+    if (overflow) {
+        qCDebug(lcDirWatcher) << "readEvents: event queue overflowed, requesting a rescan";
+        m_flushTimer.stop();
+        m_pending.clear();
+        m_removedDirs.clear();
+        m_createdDirs.clear();
+        emit overflowed();
+        return;
+    }
+
+    if (!m_flushTimer.isActive() && (!m_pending.isEmpty() || !m_removedDirs.isEmpty())) {
+        m_flushTimer.start();
+    }
+}
+
+void DirWatcher::flush() {
+    Changes changes;
+    for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it) {
+        (it.value() ? changes.added : changes.removed) << it.key();
+    }
+    changes.removedDirs = m_removedDirs.values();
+    changes.createdDirs = m_createdDirs.values();
+
+    m_pending.clear();
+    m_removedDirs.clear();
+    m_createdDirs.clear();
+
+    emit changed(changes);
+}
+
+} // namespace caelestia::models
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <qhash.h>
+#include <qobject.h>
+#include <qset.h>
+#include <qsocketnotifier.h>
+#include <qstringlist.h>
+#include <qtimer.h>
+
+namespace caelestia::models {
+
+// Recursive inotify watch on a tree which reports what was created and removed rather than which dirs changed.
+// Bursts of events are coalesced into one report.
+class DirWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    struct Changes {
+        QStringList added;       // created, moved in or finished writing, may include paths that already existed
+        QStringList removed;     // deleted or moved out
+        QStringList removedDirs; // deleted or moved out dirs, everything under them went with them
+        QStringList createdDirs; // new dirs under a recursive watch, their contents have not been reported
+    };
+
+    explicit DirWatcher(QObject* parent = nullptr);
+    ~DirWatcher() override;
+
+    // Replaces whatever was being watched, an empty path stops watching
+    void setRoot(const QString& path, bool recursive, bool showHidden);
+
+signals:
+    void changed(const caelestia::models::DirWatcher::Changes& changes);
+    // Events were dropped, the only way to catch up is a full rescan
+    void overflowed();
+
+private:
+    int m_fd;
+    QSocketNotifier* m_notifier;
+    QTimer m_flushTimer;
+
+    QString m_root;
+    bool m_recursive;
+    bool m_showHidden;
+    quint64 m_generation;
+
+    QHash<int, QString> m_dirs;
+    QHash<QString, int> m_watches;
+
+    QHash<QString, bool> m_pending; // whether each touched path exists as of the last event
+    QSet<QString> m_removedDirs;
+    QSet<QString> m_createdDirs;
+
+    bool addWatch(const QString& path, bool follow = false); // follow only applies to path itself
+    void addWatches(const QString& path);
+    void removeWatches(const QString& path);
+    void clearWatches();
+    void readEvents();
+    void flush();
+};
+
+} // namespace caelestia::models
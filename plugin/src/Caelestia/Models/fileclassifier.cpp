@@ -0,0 +1,85 @@
+#include "fileclassifier.hpp"
+
+#include <fcntl.h>
+#include <qfile.h>
+#include <qtconcurrentrun.h>
+#include <unistd.h>
+
+namespace caelestia::models {
+
+namespace {
+
+constexpr qsizetype BATCH_SIZE = 64;
+constexpr int MAX_RUNNING = 2;
+constexpr off_t READAHEAD_SIZE = 65536; // enough for any format's header
+
+} // namespace
+
+FileClassifier::FileClassifier(QObject* parent)
+    : QObject(parent)
+    , m_running(0)
+    , m_generation(0) {}
+
+void FileClassifier::enqueue(const QStringList& paths) {
+    m_queue.insert(m_queue.end(), paths.cbegin(), paths.cend());
+    pump();
+}
+
+void FileClassifier::clear() {
+    ++m_generation;
+    m_queue.clear();
+}
+
+void FileClassifier::pump() {
+    while (m_running < MAX_RUNNING && !m_queue.empty()) {
+        QStringList batch;
+        batch.reserve(BATCH_SIZE);
+        while (batch.size() < BATCH_SIZE && !m_queue.empty()) {
+            batch << std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        ++m_running;
+        const auto generation = m_generation;
+        QtConcurrent::run(&FileClassifier::classify, batch).then(this, [generation, this](const QList<Result>& results) {
+            --m_running;
+            if (generation == m_generation) {
+                emit classified(results);
+            }
+            pump();
+        });
+    }
+}
+
+QList<FileClassifier::Result> FileClassifier::classify(const QStringList& paths) {
+    auto& index = MetadataIndex::instance();
+
+    QList<Result> results;
+    results.reserve(paths.size());
+
+    QStringList unknown;
+    for (const auto& path : paths) {
+        if (const auto metadata = index.find(path)) {
+            results.append({ path, *metadata });
+        } else {
+            unknown << path;
+        }
+    }
+
+    // Ask for every header up front so the reads overlap rather than waiting on each other
+    for (const auto& path : std::as_const(unknown)) {
+        const int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, READAHEAD_SIZE, POSIX_FADV_WILLNEED);
+            close(fd);
+        }
+    }
+
+    for (const auto& path : std::as_const(unknown)) {
+        results.append({ path, index.get(path) });
+    }
+
+    return results;
+}
+
+} // namespace caelestia::models
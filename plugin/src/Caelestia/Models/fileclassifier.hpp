@@ -0,0 +1,38 @@
+#pragma once
+
+#include "metadataindex.hpp"
+#include <deque>
+#include <qlist.h>
+#include <qobject.h>
+#include <qpair.h>
+#include <qstringlist.h>
+
+namespace caelestia::models {
+
+// Works out file metadata off the main thread. Only a couple of batches run at once so a big directory can't flood
+// the disk, and each batch is reported as soon as it's done.
+class FileClassifier : public QObject {
+    Q_OBJECT
+
+public:
+    using Result = QPair<QString, MetadataIndex::Metadata>;
+
+    explicit FileClassifier(QObject* parent = nullptr);
+
+    void enqueue(const QStringList& paths);
+    // Drops everything queued, batches already running are not reported
+    void clear();
+
+signals:
+    void classified(const QList<caelestia::models::FileClassifier::Result>& results);
+
+private:
+    std::deque<QString> m_queue;
+    int m_running;
+    quint64 m_generation;
+
+    void pump();
+    [[nodiscard]] static QList<Result> classify(const QStringList& paths);
+};
+
+} // namespace caelestia::models
@@ -1,18 +1,80 @@
 #include "filesystemmodel.hpp"
 
-#include <qdiriterator.h>
-#include <qfuturewatcher.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <qimagereader.h>
 #include <qtconcurrentrun.h>
+#include <utility>
 
 namespace caelestia::models {
 
-FileSystemEntry::FileSystemEntry(const QString& path, const QString& relativePath, QObject* parent)
+namespace {
+
+constexpr quint8 FLAG_DIR = 1;
+constexpr quint8 FLAG_IMAGE = 2;
+constexpr qsizetype MIN_COMPACT_CHARS = 65536;
+constexpr char KEY_SEPARATOR = '\x01';
+constexpr char KEY_NUMBER = '0'; // where the digits would have sorted
+constexpr int ENTRIES_INTERVAL = 500; // ms between entriesChanged while scanning
+
+// Case folded and decomposed with accents dropped, and runs of digits replaced by their length and value so 2 sorts
+// before 10. Plain memcmp of two keys then gives a natural order, with separators first so dirs stay together.
+void appendSortKey(QStringView path, QByteArray& out) {
+    const auto folded = path.toString().toCaseFolded().normalized(QString::NormalizationForm_KD);
+
+    QString text; // non ascii, converted a run at a time
+    const auto flushText = [&text, &out]() {
+        if (!text.isEmpty()) {
+            out += text.toUtf8();
+            text.clear();
+        }
+    };
+
+    for (qsizetype i = 0; i < folded.size();) {
+        const auto ch = folded.at(i);
+
+        if (ch.isDigit()) {
+            flushText();
+            while (i < folded.size() && folded.at(i).isDigit() && folded.at(i).digitValue() == 0) {
+                ++i;
+            }
+
+            const auto start = out.size();
+            out += KEY_NUMBER;
+            out += '\0';
+            for (; i < folded.size() && folded.at(i).isDigit(); ++i) {
+                out += static_cast<char>('0' + folded.at(i).digitValue());
+            }
+            out[start + 1] = static_cast<char>(std::min<qsizetype>(out.size() - start - 2, 255));
+            continue;
+        }
+
+        if (ch == '/') {
+            flushText();
+            out += KEY_SEPARATOR;
+        } else if (ch.unicode() < 0x80) {
+            flushText();
+            out += static_cast<char>(ch.unicode());
+        } else if (ch.category() != QChar::Mark_NonSpacing) {
+            text += ch;
+        }
+        ++i;
+    }
+    flushText();
+}
+
+} // namespace
+
+FileSystemEntry::FileSystemEntry(const QString& path, const QString& relativePath, qint64 size, bool isDir,
+    const MetadataIndex::Metadata& metadata, QObject* parent)
     : QObject(parent)
-    , m_fileInfo(path)
     , m_path(path)
     , m_relativePath(relativePath)
-    , m_isImageInitialised(false)
-    , m_mimeTypeInitialised(false) {}
+    , m_size(size)
+    , m_isDir(isDir)
+    , m_metadata(metadata) {}
 
 QString FileSystemEntry::path() const {
     return m_path;
@@ -23,45 +85,47 @@ QString FileSystemEntry::relativePath() const {
 };
 
 QString FileSystemEntry::name() const {
-    return m_fileInfo.fileName();
+    return m_path.sliced(m_path.lastIndexOf('/') + 1);
 };
 
 QString FileSystemEntry::baseName() const {
-    return m_fileInfo.baseName();
+    const auto name = this->name();
+    return name.left(name.indexOf('.'));
 };
 
 QString FileSystemEntry::parentDir() const {
-    return m_fileInfo.absolutePath();
+    const auto slash = m_path.lastIndexOf('/');
+    return slash > 0 ? m_path.left(slash) : QStringLiteral("/");
 };
 
 QString FileSystemEntry::suffix() const {
-    return m_fileInfo.completeSuffix();
+    const auto name = this->name();
+    const auto dot = name.indexOf('.');
+    return dot < 0 ? QString() : name.sliced(dot + 1);
 };
 
 qint64 FileSystemEntry::size() const {
-    return m_fileInfo.size();
+    return m_size;
 };
 
 bool FileSystemEntry::isDir() const {
-    return m_fileInfo.isDir();
+    return m_isDir;
 };
 
 bool FileSystemEntry::isImage() const {
-    if (!m_isImageInitialised) {
-        QImageReader reader(m_path);
-        m_isImage = reader.canRead();
-        m_isImageInitialised = true;
-    }
-    return m_isImage;
+    return m_metadata.isImage;
 }
 
 QString FileSystemEntry::mimeType() const {
-    if (!m_mimeTypeInitialised) {
-        static const QMimeDatabase s_db;
-        m_mimeType = s_db.mimeTypeForFile(m_path).name();
-        m_mimeTypeInitialised = true;
+    return m_metadata.mimeType;
+}
+
+void FileSystemEntry::setMetadata(const MetadataIndex::Metadata& metadata) {
+    const bool changed = m_metadata.isImage != metadata.isImage || m_metadata.mimeType != metadata.mimeType;
+    m_metadata = metadata;
+    if (changed) {
+        emit metadataChanged();
     }
-    return m_mimeType;
 }
 
 void FileSystemEntry::updateRelativePath(const QDir& dir) {
@@ -74,26 +138,39 @@ void FileSystemEntry::updateRelativePath(const QDir& dir) {
 
 FileSystemModel::FileSystemModel(QObject* parent)
     : QAbstractListModel(parent)
+    , m_entriesTimer(new QTimer(this))
+    , m_deadChars(0)
+    , m_slotsByPath(0, SlotHash{ this }, SlotEqual{ this })
+    , m_mimeTypeNames{ QString() }
     , m_recursive(false)
     , m_watchChanges(true)
     , m_showHidden(false)
-    , m_filter(NoFilter) {
-    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &FileSystemModel::watchDirIfRecursive);
-    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &FileSystemModel::updateEntriesForDir);
+    , m_filter(NoFilter)
+    , m_generation(0) {
+    // Scans look files up from worker threads, make sure the index is created here first
+    MetadataIndex::instance();
+
+    m_entriesTimer->setSingleShot(true);
+    m_entriesTimer->setInterval(ENTRIES_INTERVAL);
+    connect(m_entriesTimer, &QTimer::timeout, this, &FileSystemModel::entriesChanged);
+
+    connect(&m_watcher, &DirWatcher::changed, this, &FileSystemModel::applyWatchedChanges);
+    connect(&m_watcher, &DirWatcher::overflowed, this, &FileSystemModel::update);
+    connect(&m_classifier, &FileClassifier::classified, this, &FileSystemModel::applyMetadata);
 }
 
 int FileSystemModel::rowCount(const QModelIndex& parent) const {
     if (parent != QModelIndex()) {
         return 0;
     }
-    return static_cast<int>(m_entries.size());
+    return static_cast<int>(m_rows.size());
 }
 
 QVariant FileSystemModel::data(const QModelIndex& index, int role) const {
-    if (role != Qt::UserRole || !index.isValid() || index.row() >= m_entries.size()) {
+    if (role != Qt::UserRole || !index.isValid() || index.row() >= rowCount()) {
         return QVariant();
     }
-    return QVariant::fromValue(m_entries.at(index.row()));
+    return QVariant::fromValue(entryAt(index.row()));
 }
 
 QHash<int, QByteArray> FileSystemModel::roleNames() const {
@@ -113,10 +190,27 @@ void FileSystemModel::setPath(const QString& path) {
     emit pathChanged();
 
     m_dir.setPath(m_path);
+    m_dirPrefix = QDir::cleanPath(m_path);
+    if (!m_dirPrefix.endsWith('/')) {
+        m_dirPrefix += '/';
+    }
+
+    // Nothing from the old dir is staying
+    m_classifier.clear();
+
+    for (auto* const wrapper : m_wrappers) {
+        if (wrapper) {
+            wrapper->updateRelativePath(m_dir);
+        }
+    }
 
-    for (const auto& entry : std::as_const(m_entries)) {
-        entry->updateRelativePath(m_dir);
+    // Relative paths are what's sorted on, so whatever survives the rescan needs new keys
+    QByteArray keys;
+    for (const auto slot : m_rows) {
+        setSortKey(slot, keys);
     }
+    m_keyChars = std::move(keys);
+    sortRows();
 
     update();
 }
@@ -178,7 +272,22 @@ void FileSystemModel::setSortReverse(bool sortReverse) {
     m_sortReverse = sortReverse;
     emit sortReverseChanged();
 
-    update();
+    sortRows();
+}
+
+FileSystemModel::SortBy FileSystemModel::sortBy() const {
+    return m_sortBy;
+}
+
+void FileSystemModel::setSortBy(SortBy sortBy) {
+    if (m_sortBy == sortBy) {
+        return;
+    }
+
+    m_sortBy = sortBy;
+    emit sortByChanged();
+
+    sortRows();
 }
 
 FileSystemModel::Filter FileSystemModel::filter() const {
@@ -212,33 +321,55 @@ void FileSystemModel::setNameFilters(const QStringList& nameFilters) {
 }
 
 QQmlListProperty<FileSystemEntry> FileSystemModel::entries() {
-    return QQmlListProperty<FileSystemEntry>(this, &m_entries);
+    return QQmlListProperty<FileSystemEntry>(this, nullptr, &FileSystemModel::listCount, &FileSystemModel::listAt);
 }
 
-void FileSystemModel::watchDirIfRecursive(const QString& path) {
-    if (m_recursive && m_watchChanges) {
-        const auto currentDir = m_dir;
-        const bool showHidden = m_showHidden;
-        auto future = QtConcurrent::run([showHidden, path]() {
-            QDir::Filters filters = QDir::Dirs | QDir::NoDotAndDotDot;
-            if (showHidden) {
-                filters |= QDir::Hidden;
-            }
+QStringList FileSystemModel::paths() const {
+    QStringList paths;
+    paths.reserve(static_cast<qsizetype>(m_rows.size()));
+    for (const auto slot : m_rows) {
+        paths << pathAt(slot).toString();
+    }
+    return paths;
+}
 
-            QDirIterator iter(path, filters, QDirIterator::Subdirectories);
-            QStringList dirs;
-            while (iter.hasNext()) {
-                dirs << iter.next();
-            }
-            return dirs;
-        });
-        future.then(this, [currentDir, showHidden, this](const QStringList& paths) {
-            if (currentDir == m_dir && showHidden == m_showHidden && !paths.isEmpty()) {
-                // Ignore if dir or showHidden has changed
-                m_watcher.addPaths(paths);
-            }
-        });
+QStringList FileSystemModel::relativePaths() const {
+    QStringList paths;
+    paths.reserve(static_cast<qsizetype>(m_rows.size()));
+    for (const auto slot : m_rows) {
+        paths << relativePathAt(slot).toString();
     }
+    return paths;
+}
+
+FileSystemEntry* FileSystemModel::get(int row) const {
+    if (row < 0 || static_cast<size_t>(row) >= m_rows.size()) {
+        return nullptr;
+    }
+    return entryAt(row);
+}
+
+DirScanner::Options FileSystemModel::scanOptions() const {
+    DirScanner::Options options;
+    options.recursive = m_recursive;
+    options.showHidden = m_showHidden;
+    options.nameFilters = m_nameFilters;
+
+    if (m_filter == Images) {
+        const auto formats = QImageReader::supportedImageFormats();
+        for (const auto& format : formats) {
+            options.nameFilters << "*." + format;
+        }
+        options.dirs = false;
+        options.accept = [](const QString& path) {
+            return MetadataIndex::instance().get(path).isImage;
+        };
+    } else {
+        options.files = m_filter != Dirs;
+        options.dirs = m_filter != Files;
+    }
+
+    return options;
 }
 
 void FileSystemModel::update() {
@@ -247,223 +378,602 @@ void FileSystemModel::update() {
 }
 
 void FileSystemModel::updateWatcher() {
-    if (!m_watcher.directories().isEmpty()) {
-        m_watcher.removePaths(m_watcher.directories());
-    }
-
-    if (!m_watchChanges || m_path.isEmpty()) {
-        return;
-    }
-
-    m_watcher.addPath(m_path);
-    watchDirIfRecursive(m_path);
+    m_watcher.setRoot(m_watchChanges ? m_path : QString(), m_recursive, m_showHidden);
 }
 
 void FileSystemModel::updateEntries() {
+    ++m_generation;
+
+    for (const auto& scan : std::as_const(m_scans)) {
+        scan.watcher->cancel();
+    }
+    m_scans.clear();
+
     if (m_path.isEmpty()) {
-        if (!m_entries.isEmpty()) {
+        if (!m_rows.empty()) {
             beginResetModel();
-            qDeleteAll(m_entries);
-            m_entries.clear();
+            clear();
             endResetModel();
+            m_entriesTimer->stop();
             emit entriesChanged();
         }
 
         return;
     }
 
-    for (auto& future : m_futures) {
-        future.cancel();
-    }
-    m_futures.clear();
-
     updateEntriesForDir(m_path);
 }
 
 void FileSystemModel::updateEntriesForDir(const QString& dir) {
-    const auto recursive = m_recursive;
-    const auto showHidden = m_showHidden;
-    const auto filter = m_filter;
-    const auto nameFilters = m_nameFilters;
-
-    QSet<QString> oldPaths;
-    for (const auto& entry : std::as_const(m_entries)) {
-        oldPaths << entry->path();
-    }
-
-    auto future = QtConcurrent::run([=](QPromise<QPair<QSet<QString>, QSet<QString>>>& promise) {
-        const auto flags = recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags;
+    auto* const scan = new QFutureWatcher<QList<DirScanner::Entry>>(this);
 
-        std::optional<QDirIterator> iter;
+    // Batches are inserted as they arrive, removals have to wait until the whole dir has been seen
+    connect(scan, &QFutureWatcherBase::resultsReadyAt, this, [dir, scan, this](int begin, int end) {
+        // Batches reported right before a cancel can still come through
+        const auto it = m_scans.find(dir);
+        if (scan->isCanceled() || it == m_scans.end() || it->watcher != scan) {
+            return;
+        }
 
-        if (filter == Images) {
-            QStringList extraNameFilters = nameFilters;
-            const auto formats = QImageReader::supportedImageFormats();
-            for (const auto& format : formats) {
-                extraNameFilters << "*." + format;
+        QList<DirScanner::Entry> added;
+        for (int i = begin; i < end; ++i) {
+            const auto batch = scan->resultAt(i);
+            for (const auto& entry : batch) {
+                it->seen.insert(entry.path);
+                if (!contains(entry.path)) {
+                    added << entry;
+                }
             }
+        }
 
-            QDir::Filters filters = QDir::Files;
-            if (showHidden) {
-                filters |= QDir::Hidden;
-            }
+        if (!added.isEmpty()) {
+            applyChanges({}, added);
+        }
+    });
+    connect(scan, &QFutureWatcherBase::finished, this, [dir, scan, this]() {
+        scan->deleteLater();
+        const auto it = m_scans.find(dir);
+        if (it == m_scans.end() || it->watcher != scan) {
+            return;
+        }
+        const auto seen = std::move(it->seen);
+        m_scans.erase(it);
+        if (scan->isCanceled()) {
+            return;
+        }
 
-            iter.emplace(dir, extraNameFilters, filters, flags);
-        } else {
-            QDir::Filters filters;
-
-            if (filter == Files) {
-                filters = QDir::Files;
-            } else if (filter == Dirs) {
-                filters = QDir::Dirs | QDir::NoDotAndDotDot;
-            } else {
-                filters = QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot;
+        // A full rescan also drops anything left over from a previous path
+        const bool full = dir == m_path;
+        const auto prefix = dir.endsWith('/') ? dir : dir + '/';
+        QSet<QString> removed;
+        for (const auto slot : m_rows) {
+            const auto path = pathAt(slot);
+            if (full || path.startsWith(prefix)) {
+                auto pathString = path.toString();
+                if (!seen.contains(pathString)) {
+                    removed << std::move(pathString);
+                }
             }
+        }
 
-            if (showHidden) {
-                filters |= QDir::Hidden;
-            }
+        if (!removed.isEmpty()) {
+            applyChanges(removed, {});
+        }
 
-            if (nameFilters.isEmpty()) {
-                iter.emplace(dir, filters, flags);
-            } else {
-                iter.emplace(dir, nameFilters, filters, flags);
-            }
+        // Let everything held back while scanning through at once
+        if (m_scans.isEmpty() && m_entriesTimer->isActive()) {
+            m_entriesTimer->stop();
+            emit entriesChanged();
         }
+    });
 
-        QSet<QString> newPaths;
-        while (iter->hasNext()) {
-            if (promise.isCanceled()) {
-                return;
-            }
+    if (const auto old = m_scans.take(dir); old.watcher) {
+        old.watcher->cancel();
+    }
+    m_scans.insert(dir, { scan, {} });
+
+    scan->setFuture(QtConcurrent::run([dir, options = scanOptions()](QPromise<QList<DirScanner::Entry>>& promise) {
+        DirScanner::scan(
+            dir, options,
+            [&promise](QList<DirScanner::Entry>&& batch) {
+                promise.addResult(std::move(batch));
+            },
+            [&promise]() {
+                return promise.isCanceled();
+            });
+    }));
+}
 
-            QString path = iter->next();
+void FileSystemModel::applyWatchedChanges(const DirWatcher::Changes& changes) {
+    QSet<QString> removed;
+    for (const auto& path : changes.removed) {
+        if (contains(path)) {
+            removed << path;
+        }
+    }
 
-            if (filter == Images) {
-                QImageReader reader(path);
-                if (!reader.canRead()) {
-                    continue;
+    if (!changes.removedDirs.isEmpty()) {
+        QStringList prefixes;
+        for (const auto& dir : changes.removedDirs) {
+            prefixes << dir + '/';
+        }
+        for (const auto slot : m_rows) {
+            const auto path = pathAt(slot);
+            for (const auto& prefix : std::as_const(prefixes)) {
+                if (path.startsWith(prefix)) {
+                    removed << path.toString();
+                    break;
                 }
             }
-
-            newPaths.insert(path);
         }
+    }
+
+    if (!removed.isEmpty()) {
+        applyChanges(removed, {});
+    }
+
+    // New dirs may have filled up before they were watched
+    for (const auto& dir : changes.createdDirs) {
+        updateEntriesForDir(dir);
+    }
+
+    if (changes.added.isEmpty()) {
+        return;
+    }
 
-        if (promise.isCanceled()) {
+    // Classifying can mean reading file headers, which doesn't belong on this thread
+    const auto generation = m_generation;
+    QtConcurrent::run([paths = changes.added, options = scanOptions()]() {
+        return DirScanner::classify(paths, options);
+    }).then(this, [generation, this](const QList<DirScanner::Entry>& entries) {
+        if (generation != m_generation) {
             return;
         }
 
-        promise.addResult(qMakePair(oldPaths - newPaths, newPaths - oldPaths));
+        QList<DirScanner::Entry> added;
+        for (const auto& entry : entries) {
+            if (!contains(entry.path)) {
+                added << entry;
+            }
+        }
+
+        if (!added.isEmpty()) {
+            applyChanges({}, added);
+        }
     });
+}
 
-    if (m_futures.contains(dir)) {
-        m_futures[dir].cancel();
+void FileSystemModel::applyChanges(const QSet<QString>& removedPaths, const QList<DirScanner::Entry>& addedEntries) {
+    std::vector<int> removedRows;
+    for (const auto& path : removedPaths) {
+        const auto it = m_slotsByPath.find(QStringView(path));
+        if (it != m_slotsByPath.end()) {
+            if (const auto row = rowOf(*it); row >= 0) {
+                removedRows.push_back(row);
+            }
+        }
     }
-    m_futures.insert(dir, future);
+    std::sort(removedRows.begin(), removedRows.end(), std::greater<int>());
+
+    // Remove from the bottom up in contiguous runs, so rows found earlier stay valid
+    for (size_t i = 0; i < removedRows.size();) {
+        const int last = removedRows[i];
+        int first = last;
+        for (++i; i < removedRows.size() && removedRows[i] == first - 1; ++i) {
+            first = removedRows[i];
+        }
 
-    future
-        .then(this,
-            [dir, this](QPair<QSet<QString>, QSet<QString>> result) {
-                m_futures.remove(dir);
-                if (!result.first.isEmpty() || !result.second.isEmpty()) {
-                    applyChanges(result.first, result.second);
-                }
-            })
-        .onCanceled(this, [dir, this]() {
-            m_futures.remove(dir);
-        });
-}
-
-void FileSystemModel::applyChanges(const QSet<QString>& removedPaths, const QSet<QString>& addedPaths) {
-    QList<int> removedIndices;
-    for (int i = 0; i < m_entries.size(); ++i) {
-        if (removedPaths.contains(m_entries[i]->path())) {
-            removedIndices << i;
-        }
-    }
-    std::sort(removedIndices.begin(), removedIndices.end(), std::greater<int>());
-
-    // Batch remove old entries
-    int start = -1;
-    int end = -1;
-    for (int idx : std::as_const(removedIndices)) {
-        if (start == -1) {
-            start = idx;
-            end = idx;
-        } else if (idx == end - 1) {
-            end = idx;
-        } else {
-            beginRemoveRows(QModelIndex(), end, start);
-            for (int i = start; i >= end; --i) {
-                m_entries.takeAt(i)->deleteLater();
-            }
-            endRemoveRows();
+        beginRemoveRows(QModelIndex(), first, last);
+        const auto begin = m_rows.begin() + first;
+        const auto end = m_rows.begin() + last + 1;
+        for (auto it = begin; it != end; ++it) {
+            freeSlot(*it);
+        }
+        m_rows.erase(begin, end);
+        endRemoveRows();
+    }
+    compact();
+
+    std::vector<quint32> newSlots;
+    QStringList newPaths;
+    for (const auto& added : addedEntries) {
+        if (!contains(added.path)) {
+            newSlots.push_back(allocSlot(added));
+            newPaths << added.path;
+        }
+    }
 
-            start = idx;
-            end = idx;
+    // Scans still running may have read the dirs of these before they appeared, don't let them drop them
+    for (auto& scan : m_scans) {
+        for (const auto& path : std::as_const(newPaths)) {
+            scan.seen.insert(path);
         }
     }
-    if (start != -1) {
-        beginRemoveRows(QModelIndex(), end, start);
-        for (int i = start; i >= end; --i) {
-            m_entries.takeAt(i)->deleteLater();
+
+    const auto less = [this](quint32 a, quint32 b) {
+        return lessSlot(a, b);
+    };
+    std::sort(newSlots.begin(), newSlots.end(), less);
+
+    // Insert in runs of new entries which all land in front of the same existing row
+    for (size_t i = 0; i < newSlots.size();) {
+        const auto pos = std::lower_bound(m_rows.begin(), m_rows.end(), newSlots[i], less) - m_rows.begin();
+        const auto next = static_cast<size_t>(pos);
+        size_t end = i + 1;
+        while (end < newSlots.size() && (next == m_rows.size() || lessSlot(newSlots[end], m_rows[next]))) {
+            ++end;
         }
-        endRemoveRows();
+
+        const auto row = static_cast<int>(pos);
+        beginInsertRows(QModelIndex(), row, row + static_cast<int>(end - i) - 1);
+        m_rows.insert(m_rows.begin() + pos, newSlots.begin() + static_cast<qsizetype>(i),
+            newSlots.begin() + static_cast<qsizetype>(end));
+        endInsertRows();
+
+        i = end;
     }
 
-    // Create new entries
-    QList<FileSystemEntry*> newEntries;
-    for (const auto& path : addedPaths) {
-        newEntries << new FileSystemEntry(path, m_dir.relativeFilePath(path), this);
+    if (!newPaths.isEmpty()) {
+        m_classifier.enqueue(newPaths);
     }
-    std::sort(newEntries.begin(), newEntries.end(), [this](const FileSystemEntry* a, const FileSystemEntry* b) {
-        return compareEntries(a, b);
-    });
 
-    // Batch insert new entries
-    int insertStart = -1;
-    QList<FileSystemEntry*> batchItems;
-    for (const auto& entry : std::as_const(newEntries)) {
-        const auto it = std::lower_bound(
-            m_entries.begin(), m_entries.end(), entry, [this](const FileSystemEntry* a, const FileSystemEntry* b) {
-                return compareEntries(a, b);
-            });
-        const auto row = static_cast<int>(it - m_entries.begin());
+    notifyEntries();
+}
 
-        if (insertStart == -1) {
-            insertStart = row;
-            batchItems << entry;
-        } else if (row == insertStart + batchItems.size()) {
-            batchItems << entry;
-        } else {
-            beginInsertRows(QModelIndex(), insertStart, insertStart + static_cast<int>(batchItems.size()) - 1);
-            for (int i = 0; i < batchItems.size(); ++i) {
-                m_entries.insert(insertStart + i, batchItems[i]);
+void FileSystemModel::applyMetadata(const QList<FileClassifier::Result>& results) {
+    bool moved = false;
+    for (const auto& [path, metadata] : results) {
+        const auto it = m_slotsByPath.find(QStringView(path));
+        if (it == m_slotsByPath.end()) {
+            continue;
+        }
+
+        const auto slot = *it;
+        const auto size = metadata.imageSize;
+        const auto pixels = size.isValid() ? static_cast<qint64>(size.width()) * size.height() : 0;
+        if (m_sortBy == Dimensions && pixels != m_pixels[slot]) {
+            // Has to be found while it is still in order
+            const auto row = rowOf(slot);
+            m_pixels[slot] = pixels;
+            if (row >= 0 && resortRow(row)) {
+                moved = true;
             }
-            endInsertRows();
+        } else {
+            m_pixels[slot] = pixels;
+        }
+
+        m_mimeTypes[slot] = mimeTypeId(metadata.mimeType);
+        if (metadata.isImage) {
+            m_flags[slot] = static_cast<quint8>(m_flags[slot] | FLAG_IMAGE);
+        } else {
+            m_flags[slot] = static_cast<quint8>(m_flags[slot] & ~FLAG_IMAGE);
+        }
 
-            insertStart = row;
-            batchItems.clear();
-            batchItems << entry;
+        // Rows nothing has asked for yet will get the new metadata whenever they do
+        auto* const wrapper = m_wrappers[slot];
+        if (!wrapper) {
+            continue;
         }
+
+        wrapper->setMetadata(metadata);
+        if (const auto row = rowOf(slot); row >= 0) {
+            emit dataChanged(index(row), index(row));
+        }
+    }
+
+    if (moved) {
+        notifyEntries();
+    }
+}
+
+void FileSystemModel::notifyEntries() {
+    // Bindings on entries rebuild the whole list each time, so while scans are streaming in they only get an update
+    // every so often and once more when the last one finishes
+    if (m_scans.isEmpty()) {
+        m_entriesTimer->stop();
+        emit entriesChanged();
+    } else if (!m_entriesTimer->isActive()) {
+        m_entriesTimer->start();
     }
-    if (!batchItems.isEmpty()) {
-        beginInsertRows(QModelIndex(), insertStart, insertStart + static_cast<int>(batchItems.size()) - 1);
-        for (int i = 0; i < batchItems.size(); ++i) {
-            m_entries.insert(insertStart + i, batchItems[i]);
+}
+
+size_t FileSystemModel::SlotHash::operator()(quint32 slot) const {
+    return qHash(model->pathAt(slot));
+}
+
+size_t FileSystemModel::SlotHash::operator()(QStringView path) const {
+    return qHash(path);
+}
+
+bool FileSystemModel::SlotEqual::operator()(quint32 a, quint32 b) const {
+    return a == b;
+}
+
+bool FileSystemModel::SlotEqual::operator()(QStringView a, quint32 b) const {
+    return a == model->pathAt(b);
+}
+
+bool FileSystemModel::SlotEqual::operator()(quint32 a, QStringView b) const {
+    return model->pathAt(a) == b;
+}
+
+QStringView FileSystemModel::pathAt(quint32 slot) const {
+    return QStringView(m_pathChars).sliced(m_pathOffsets[slot], m_pathLengths[slot]);
+}
+
+QStringView FileSystemModel::relativePathAt(quint32 slot) const {
+    const auto path = pathAt(slot);
+    return path.startsWith(m_dirPrefix) ? path.sliced(m_dirPrefix.size()) : path;
+}
+
+MetadataIndex::Metadata FileSystemModel::metadataAt(quint32 slot) const {
+    MetadataIndex::Metadata metadata;
+    metadata.mimeType = m_mimeTypeNames.at(m_mimeTypes[slot]);
+    metadata.size = m_sizes[slot];
+    metadata.isImage = m_flags[slot] & FLAG_IMAGE;
+    return metadata;
+}
+
+bool FileSystemModel::contains(const QString& path) const {
+    return m_slotsByPath.contains(QStringView(path));
+}
+
+int FileSystemModel::rowOf(quint32 slot) const {
+    const auto less = [this](quint32 a, quint32 b) {
+        return lessSlot(a, b);
+    };
+    // Different paths can still collate equally, so look through the whole run of equal rows
+    for (auto it = std::lower_bound(m_rows.cbegin(), m_rows.cend(), slot, less);
+        it != m_rows.cend() && !lessSlot(slot, *it); ++it) {
+        if (*it == slot) {
+            return static_cast<int>(it - m_rows.cbegin());
         }
-        endInsertRows();
     }
+    return -1;
+}
 
-    emit entriesChanged();
+FileSystemEntry* FileSystemModel::entryAt(qsizetype row) const {
+    const auto slot = m_rows[static_cast<size_t>(row)];
+    auto*& wrapper = m_wrappers[slot];
+    if (!wrapper) {
+        // Owned by the model so QML never collects it, the const is only about what the model shows
+        const auto path = pathAt(slot).toString();
+        wrapper = new FileSystemEntry(path, m_dir.relativeFilePath(path), m_sizes[slot], m_flags[slot] & FLAG_DIR,
+            metadataAt(slot), const_cast<FileSystemModel*>(this));
+    }
+    return wrapper;
 }
 
-bool FileSystemModel::compareEntries(const FileSystemEntry* a, const FileSystemEntry* b) const {
-    if (a->isDir() != b->isDir()) {
-        return m_sortReverse ^ a->isDir();
+int FileSystemModel::compareKeys(quint32 a, quint32 b) const {
+    const auto lengthA = m_keyLengths[a];
+    const auto lengthB = m_keyLengths[b];
+    const int cmp = std::memcmp(m_keyChars.constData() + m_keyOffsets[a], m_keyChars.constData() + m_keyOffsets[b],
+        std::min(lengthA, lengthB));
+    if (cmp != 0 || lengthA == lengthB) {
+        return cmp;
+    }
+    return lengthA < lengthB ? -1 : 1;
+}
+
+bool FileSystemModel::lessSlot(quint32 a, quint32 b) const {
+    const bool aDir = m_flags[a] & FLAG_DIR;
+    const bool bDir = m_flags[b] & FLAG_DIR;
+    if (aDir != bDir) {
+        return m_sortReverse ^ aDir;
+    }
+
+    const std::vector<qint64>* column = nullptr;
+    switch (m_sortBy) {
+    case Modified:
+        column = &m_mtimes;
+        break;
+    case Size:
+        column = &m_sizes;
+        break;
+    case Dimensions:
+        column = &m_pixels;
+        break;
+    case Name:
+        break;
+    }
+    if (column && (*column)[a] != (*column)[b]) {
+        return m_sortReverse ? (*column)[a] > (*column)[b] : (*column)[a] < (*column)[b];
+    }
+
+    // Keys only tie for paths differing in case, accents or leading zeros
+    auto cmp = compareKeys(a, b);
+    if (cmp == 0) {
+        cmp = pathAt(a).compare(pathAt(b));
     }
-    const auto cmp = a->relativePath().localeAwareCompare(b->relativePath());
     return m_sortReverse ? cmp > 0 : cmp < 0;
 }
 
+quint16 FileSystemModel::mimeTypeId(const QString& mimeType) {
+    if (mimeType.isEmpty()) {
+        return 0;
+    }
+
+    const auto it = m_mimeTypeIds.constFind(mimeType);
+    if (it != m_mimeTypeIds.cend()) {
+        return *it;
+    }
+
+    // There aren't nearly this many mime types, but don't wrap around if there ever are
+    if (m_mimeTypeNames.size() > std::numeric_limits<quint16>::max()) {
+        return 0;
+    }
+
+    const auto id = static_cast<quint16>(m_mimeTypeNames.size());
+    m_mimeTypeNames << mimeType;
+    m_mimeTypeIds.insert(mimeType, id);
+    return id;
+}
+
+quint32 FileSystemModel::allocSlot(const DirScanner::Entry& entry) {
+    quint32 slot;
+    if (m_freeSlots.empty()) {
+        slot = static_cast<quint32>(m_sizes.size());
+        m_pathOffsets.push_back(0);
+        m_pathLengths.push_back(0);
+        m_keyOffsets.push_back(0);
+        m_keyLengths.push_back(0);
+        m_sizes.push_back(0);
+        m_mtimes.push_back(0);
+        m_pixels.push_back(0);
+        m_flags.push_back(0);
+        m_mimeTypes.push_back(0);
+        m_wrappers.push_back(nullptr);
+    } else {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+
+    m_pathOffsets[slot] = m_pathChars.size();
+    m_pathLengths[slot] = static_cast<quint32>(entry.path.size());
+    m_pathChars += entry.path;
+    setSortKey(slot, m_keyChars);
+    m_sizes[slot] = entry.size;
+    m_mtimes[slot] = entry.mtime;
+    m_pixels[slot] = 0;
+    m_flags[slot] = static_cast<quint8>(entry.isDir ? FLAG_DIR : 0);
+    m_mimeTypes[slot] = 0;
+
+    m_slotsByPath.insert(slot);
+    return slot;
+}
+
+void FileSystemModel::freeSlot(quint32 slot) {
+    // Hashed by path, so has to go before the path does
+    m_slotsByPath.erase(slot);
+
+    if (auto* const wrapper = std::exchange(m_wrappers[slot], nullptr)) {
+        wrapper->deleteLater();
+    }
+
+    m_deadChars += m_pathLengths[slot];
+    m_pathLengths[slot] = 0;
+    m_keyLengths[slot] = 0;
+    m_freeSlots.push_back(slot);
+}
+
+void FileSystemModel::setSortKey(quint32 slot, QByteArray& keys) {
+    m_keyOffsets[slot] = keys.size();
+    appendSortKey(relativePathAt(slot), keys);
+    m_keyLengths[slot] = static_cast<quint32>(keys.size() - m_keyOffsets[slot]);
+}
+
+void FileSystemModel::compact() {
+    if (m_deadChars < MIN_COMPACT_CHARS || m_deadChars * 2 < m_pathChars.size()) {
+        return;
+    }
+
+    // Laid out in row order, which is also the order they tend to be looked at in
+    QString chars;
+    QByteArray keys;
+    chars.reserve(m_pathChars.size() - m_deadChars);
+    for (const auto slot : m_rows) {
+        const auto path = pathAt(slot);
+        m_pathOffsets[slot] = chars.size();
+        chars += path;
+
+        const auto key = QByteArrayView(m_keyChars).sliced(m_keyOffsets[slot], m_keyLengths[slot]);
+        m_keyOffsets[slot] = keys.size();
+        keys.append(key);
+    }
+
+    m_pathChars = std::move(chars);
+    m_keyChars = std::move(keys);
+    m_deadChars = 0;
+}
+
+void FileSystemModel::clear() {
+    m_slotsByPath.clear();
+    for (auto* const wrapper : m_wrappers) {
+        delete wrapper;
+    }
+
+    m_pathChars.clear();
+    m_deadChars = 0;
+    m_pathOffsets.clear();
+    m_pathLengths.clear();
+    m_keyChars.clear();
+    m_keyOffsets.clear();
+    m_keyLengths.clear();
+    m_sizes.clear();
+    m_mtimes.clear();
+    m_pixels.clear();
+    m_flags.clear();
+    m_mimeTypes.clear();
+    m_wrappers.clear();
+    m_freeSlots.clear();
+    m_rows.clear();
+}
+
+void FileSystemModel::sortRows() {
+    if (m_rows.empty()) {
+        return;
+    }
+
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+    const auto persistent = persistentIndexList();
+    std::vector<quint32> persistentSlots;
+    for (const auto& persistentIndex : persistent) {
+        persistentSlots.push_back(m_rows[static_cast<size_t>(persistentIndex.row())]);
+    }
+
+    std::stable_sort(m_rows.begin(), m_rows.end(), [this](quint32 a, quint32 b) {
+        return lessSlot(a, b);
+    });
+
+    if (!persistent.isEmpty()) {
+        std::vector<int> rows(m_wrappers.size(), -1);
+        for (size_t row = 0; row < m_rows.size(); ++row) {
+            rows[m_rows[row]] = static_cast<int>(row);
+        }
+
+        QModelIndexList moved;
+        for (const auto slot : persistentSlots) {
+            moved << index(rows[slot]);
+        }
+        changePersistentIndexList(persistent, moved);
+    }
+
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+    emit entriesChanged();
+}
+
+bool FileSystemModel::resortRow(int row) {
+    const auto less = [this](quint32 a, quint32 b) {
+        return lessSlot(a, b);
+    };
+
+    // Everything else is still in order, so only the side it moves to needs searching
+    const auto first = m_rows.begin();
+    const auto current = first + row;
+    if (current != first && less(*current, *(current - 1))) {
+        const auto to = std::lower_bound(first, current, *current, less);
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), static_cast<int>(to - first));
+        std::rotate(to, current, current + 1);
+        endMoveRows();
+        return true;
+    }
+    if (current + 1 != m_rows.end() && less(*(current + 1), *current)) {
+        const auto to = std::lower_bound(current + 1, m_rows.end(), *current, less);
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), static_cast<int>(to - first));
+        std::rotate(current, current + 1, to);
+        endMoveRows();
+        return true;
+    }
+    return false;
+}
+
+qsizetype FileSystemModel::listCount(QQmlListProperty<FileSystemEntry>* list) {
+    return static_cast<qsizetype>(static_cast<FileSystemModel*>(list->object)->m_rows.size());
+}
+
+FileSystemEntry* FileSystemModel::listAt(QQmlListProperty<FileSystemEntry>* list, qsizetype row) {
+    return static_cast<FileSystemModel*>(list->object)->entryAt(row);
+}
+
 } // namespace caelestia::models
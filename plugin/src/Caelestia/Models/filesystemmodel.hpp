@@ -1,17 +1,22 @@
 #pragma once
 
+#include "dirscanner.hpp"
+#include "dirwatcher.hpp"
+#include "fileclassifier.hpp"
+#include "metadataindex.hpp"
 #include <qabstractitemmodel.h>
 #include <qdir.h>
-#include <qfilesystemwatcher.h>
-#include <qfuture.h>
-#include <qimagereader.h>
-#include <qmimedatabase.h>
+#include <qfuturewatcher.h>
 #include <qobject.h>
 #include <qqmlintegration.h>
 #include <qqmllist.h>
+#include <qtimer.h>
+#include <unordered_set>
+#include <vector>
 
 namespace caelestia::models {
 
+// Only created for the rows something asks for, the model itself keeps everything in flat columns
 class FileSystemEntry : public QObject {
     Q_OBJECT
     QML_ELEMENT
@@ -25,11 +30,12 @@ class FileSystemEntry : public QObject {
     Q_PROPERTY(QString suffix READ suffix CONSTANT)
     Q_PROPERTY(qint64 size READ size CONSTANT)
     Q_PROPERTY(bool isDir READ isDir CONSTANT)
-    Q_PROPERTY(bool isImage READ isImage CONSTANT)
-    Q_PROPERTY(QString mimeType READ mimeType CONSTANT)
+    Q_PROPERTY(bool isImage READ isImage NOTIFY metadataChanged)
+    Q_PROPERTY(QString mimeType READ mimeType NOTIFY metadataChanged)
 
 public:
-    explicit FileSystemEntry(const QString& path, const QString& relativePath, QObject* parent = nullptr);
+    explicit FileSystemEntry(const QString& path, const QString& relativePath, qint64 size, bool isDir,
+        const MetadataIndex::Metadata& metadata, QObject* parent = nullptr);
 
     [[nodiscard]] QString path() const;
     [[nodiscard]] QString relativePath() const;
@@ -43,21 +49,20 @@ public:
     [[nodiscard]] QString mimeType() const;
 
     void updateRelativePath(const QDir& dir);
+    // Filled in by the model once it has been worked out in the background
+    void setMetadata(const MetadataIndex::Metadata& metadata);
 
 signals:
     void relativePathChanged();
+    void metadataChanged();
 
 private:
-    const QFileInfo m_fileInfo;
-
     const QString m_path;
     QString m_relativePath;
+    const qint64 m_size;
+    const bool m_isDir;
 
-    mutable bool m_isImage;
-    mutable bool m_isImageInitialised;
-
-    mutable QString m_mimeType;
-    mutable bool m_mimeTypeInitialised;
+    MetadataIndex::Metadata m_metadata;
 };
 
 class FileSystemModel : public QAbstractListModel {
@@ -69,10 +74,14 @@ class FileSystemModel : public QAbstractListModel {
     Q_PROPERTY(bool watchChanges READ watchChanges WRITE setWatchChanges NOTIFY watchChangesChanged)
     Q_PROPERTY(bool showHidden READ showHidden WRITE setShowHidden NOTIFY showHiddenChanged)
     Q_PROPERTY(bool sortReverse READ sortReverse WRITE setSortReverse NOTIFY sortReverseChanged)
+    Q_PROPERTY(SortBy sortBy READ sortBy WRITE setSortBy NOTIFY sortByChanged)
     Q_PROPERTY(Filter filter READ filter WRITE setFilter NOTIFY filterChanged)
     Q_PROPERTY(QStringList nameFilters READ nameFilters WRITE setNameFilters NOTIFY nameFiltersChanged)
 
     Q_PROPERTY(QQmlListProperty<caelestia::models::FileSystemEntry> entries READ entries NOTIFY entriesChanged)
+    // Straight from the columns, for when only the strings are needed and wrapping every row isn't worth it
+    Q_PROPERTY(QStringList paths READ paths NOTIFY entriesChanged)
+    Q_PROPERTY(QStringList relativePaths READ relativePaths NOTIFY entriesChanged)
 
 public:
     enum Filter {
@@ -83,6 +92,15 @@ public:
     };
     Q_ENUM(Filter)
 
+    // Dirs and files are sorted separately, ties are broken by name
+    enum SortBy {
+        Name,
+        Modified,
+        Size,
+        Dimensions // pixel count, only known for images once they have been classified
+    };
+    Q_ENUM(SortBy)
+
     explicit FileSystemModel(QObject* parent = nullptr);
 
     int rowCount(const QModelIndex& parent = QModelIndex()) const override;
@@ -104,6 +122,9 @@ public:
     [[nodiscard]] bool sortReverse() const;
     void setSortReverse(bool sortReverse);
 
+    [[nodiscard]] SortBy sortBy() const;
+    void setSortBy(SortBy sortBy);
+
     [[nodiscard]] Filter filter() const;
     void setFilter(Filter filter);
 
@@ -111,6 +132,11 @@ public:
     void setNameFilters(const QStringList& nameFilters);
 
     [[nodiscard]] QQmlListProperty<FileSystemEntry> entries();
+    [[nodiscard]] QStringList paths() const;
+    [[nodiscard]] QStringList relativePaths() const;
+
+    // The entry of a single row, null if out of range
+    Q_INVOKABLE caelestia::models::FileSystemEntry* get(int row) const;
 
 signals:
     void pathChanged();
@@ -118,31 +144,103 @@ signals:
     void watchChangesChanged();
     void showHiddenChanged();
     void sortReverseChanged();
+    void sortByChanged();
     void filterChanged();
     void nameFiltersChanged();
     void entriesChanged();
 
 private:
+    // Hashes and compares slots by their path in the arena, so lookups by path don't need a copy of every path
+    struct SlotHash {
+        using is_transparent = void;
+        const FileSystemModel* model;
+
+        size_t operator()(quint32 slot) const;
+        size_t operator()(QStringView path) const;
+    };
+
+    struct SlotEqual {
+        using is_transparent = void;
+        const FileSystemModel* model;
+
+        bool operator()(quint32 a, quint32 b) const;
+        bool operator()(QStringView a, quint32 b) const;
+        bool operator()(quint32 a, QStringView b) const;
+    };
+
+    struct Scan {
+        QFutureWatcher<QList<DirScanner::Entry>>* watcher = nullptr;
+        QSet<QString> seen; // found by the scan or added while it ran, the rest is removed once it finishes
+    };
+
     QDir m_dir;
-    QFileSystemWatcher m_watcher;
-    QList<FileSystemEntry*> m_entries;
-    QHash<QString, QFuture<QPair<QSet<QString>, QSet<QString>>>> m_futures;
+    QString m_dirPrefix; // cleaned path with a trailing slash
+    DirWatcher m_watcher;
+    FileClassifier m_classifier;
+    QHash<QString, Scan> m_scans;
+    QTimer* m_entriesTimer; // throttles entriesChanged while scans stream in
+
+    // Entries are stored column wise by slot. Freed slots are reused and the arenas are compacted once they are
+    // mostly dead paths.
+    QString m_pathChars;
+    qsizetype m_deadChars;
+    std::vector<qsizetype> m_pathOffsets;
+    std::vector<quint32> m_pathLengths;
+    QByteArray m_keyChars; // natural sort keys of the relative paths, see appendSortKey
+    std::vector<qsizetype> m_keyOffsets;
+    std::vector<quint32> m_keyLengths;
+    std::vector<qint64> m_sizes;
+    std::vector<qint64> m_mtimes;
+    std::vector<qint64> m_pixels; // image width * height, 0 until classified
+    std::vector<quint8> m_flags;
+    std::vector<quint16> m_mimeTypes; // index into m_mimeTypeNames
+    mutable std::vector<FileSystemEntry*> m_wrappers;
+    std::vector<quint32> m_freeSlots;
+    std::unordered_set<quint32, SlotHash, SlotEqual> m_slotsByPath;
+    std::vector<quint32> m_rows; // slots in sorted order
+
+    QStringList m_mimeTypeNames;
+    QHash<QString, quint16> m_mimeTypeIds;
 
     QString m_path;
     bool m_recursive;
     bool m_watchChanges;
     bool m_showHidden;
     bool m_sortReverse = false;
+    SortBy m_sortBy = Name;
     Filter m_filter;
     QStringList m_nameFilters;
+    quint64 m_generation;
 
-    void watchDirIfRecursive(const QString& path);
+    [[nodiscard]] DirScanner::Options scanOptions() const;
     void update();
     void updateWatcher();
     void updateEntries();
     void updateEntriesForDir(const QString& dir);
-    void applyChanges(const QSet<QString>& removedPaths, const QSet<QString>& addedPaths);
-    [[nodiscard]] bool compareEntries(const FileSystemEntry* a, const FileSystemEntry* b) const;
+    void applyWatchedChanges(const DirWatcher::Changes& changes);
+    void applyChanges(const QSet<QString>& removedPaths, const QList<DirScanner::Entry>& addedEntries);
+    void applyMetadata(const QList<FileClassifier::Result>& results);
+    void notifyEntries();
+
+    [[nodiscard]] QStringView pathAt(quint32 slot) const;
+    [[nodiscard]] QStringView relativePathAt(quint32 slot) const;
+    [[nodiscard]] MetadataIndex::Metadata metadataAt(quint32 slot) const;
+    [[nodiscard]] bool contains(const QString& path) const;
+    [[nodiscard]] int rowOf(quint32 slot) const;
+    [[nodiscard]] FileSystemEntry* entryAt(qsizetype row) const;
+    [[nodiscard]] int compareKeys(quint32 a, quint32 b) const;
+    [[nodiscard]] bool lessSlot(quint32 a, quint32 b) const;
+    [[nodiscard]] quint16 mimeTypeId(const QString& mimeType);
+    quint32 allocSlot(const DirScanner::Entry& entry);
+    void freeSlot(quint32 slot);
+    void setSortKey(quint32 slot, QByteArray& keys);
+    void compact();
+    void clear();
+    void sortRows();
+    bool resortRow(int row); // returns whether it moved
+
+    static qsizetype listCount(QQmlListProperty<FileSystemEntry>* list);
+    static FileSystemEntry* listAt(QQmlListProperty<FileSystemEntry>* list, qsizetype row);
 };
 
 } // namespace caelestia::models
@@ -0,0 +1,412 @@
+#include "metadataindex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <qcoreapplication.h>
+#include <qdir.h>
+#include <qfileinfo.h>
+#include <qimagereader.h>
+#include <qloggingcategory.h>
+#include <qmimedatabase.h>
+#include <qsavefile.h>
+#include <qset.h>
+#include <qstandardpaths.h>
+#include <qthreadpool.h>
+#include <sys/stat.h>
+#include <vector>
+
+Q_LOGGING_CATEGORY(lcMetadataIndex, "caelestia.models.metadataindex", QtInfoMsg)
+
+namespace caelestia::models {
+
+namespace {
+
+constexpr char MAGIC[8] = { 'C', 'F', 'S', 'M', 'E', 'T', 'A', '\0' };
+constexpr quint32 VERSION = 2; // 1 could hold images recorded without their dimensions
+constexpr size_t MAX_RECORDS = 1 << 18;
+constexpr int SAVE_DELAY = 5000; // ms
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 count;
+    quint64 stringsOffset;
+    quint64 stringsSize;
+};
+
+// Fixed size and sorted by hash so lookups can binary search the mapped file as is
+struct FileRecord {
+    quint64 hash;
+    quint64 inode;
+    qint64 mtime;
+    qint64 size;
+    quint32 pathOffset;
+    quint32 pathLength;
+    quint32 mimeOffset;
+    quint32 mimeLength;
+    qint32 width;
+    qint32 height;
+    quint32 flags;
+    quint32 reserved;
+};
+static_assert(sizeof(FileHeader) == 32 && sizeof(FileRecord) == 64);
+
+constexpr quint32 FLAG_IMAGE = 1;
+
+// FNV-1a, qHash isn't guaranteed to stay the same between Qt versions
+quint64 hashPath(QByteArrayView path) {
+    quint64 hash = 14695981039346656037ull;
+    for (const char c : path) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+const QMimeDatabase& mimeDatabase() {
+    static const QMimeDatabase s_db;
+    return s_db;
+}
+
+bool isImageType(const QMimeType& type) {
+    static const auto s_supported = [] {
+        QSet<QString> names;
+        const auto types = QImageReader::supportedMimeTypes();
+        for (const auto& name : types) {
+            names << QString::fromLatin1(name);
+        }
+        return names;
+    }();
+
+    if (s_supported.contains(type.name())) {
+        return true;
+    }
+    const auto aliases = type.aliases();
+    return std::any_of(aliases.cbegin(), aliases.cend(), [](const QString& alias) {
+        return s_supported.contains(alias);
+    });
+}
+
+// Names with one well known extension are trusted for the type, anything else has to be sniffed
+std::optional<MetadataIndex::Metadata> guess(const QString& path) {
+    const auto types = mimeDatabase().mimeTypesForFileName(path);
+    if (types.size() != 1) {
+        return std::nullopt;
+    }
+
+    MetadataIndex::Metadata metadata;
+    metadata.mimeType = types.first().name();
+    metadata.isImage = isImageType(types.first());
+    return metadata;
+}
+
+MetadataIndex::Metadata sniff(const QString& path) {
+    MetadataIndex::Metadata metadata;
+    QImageReader reader(path);
+    metadata.isImage = reader.canRead();
+    if (metadata.isImage) {
+        metadata.imageSize = reader.size();
+    }
+    metadata.mimeType = mimeDatabase().mimeTypeForFile(path).name();
+    return metadata;
+}
+
+} // namespace
+
+MetadataIndex::MetadataIndex()
+    : QObject(nullptr)
+    , m_path(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/caelestia/fsmetadata")
+    , m_records(nullptr)
+    , m_count(0)
+    , m_strings(nullptr)
+    , m_stringsSize(0)
+    , m_dirty(false)
+    , m_saveQueued(false) {
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(SAVE_DELAY);
+    connect(&m_saveTimer, &QTimer::timeout, this, [this]() {
+        m_saveQueued = false;
+        QThreadPool::globalInstance()->start([this]() {
+            save();
+        });
+    });
+
+    if (auto* const app = QCoreApplication::instance()) {
+        connect(app, &QCoreApplication::aboutToQuit, this, [this]() {
+            m_saveTimer.stop();
+            save();
+        });
+    }
+
+    load();
+}
+
+MetadataIndex& MetadataIndex::instance() {
+    static MetadataIndex instance;
+    return instance;
+}
+
+std::optional<MetadataIndex::Metadata> MetadataIndex::find(const QString& path) {
+    Stamp stamp{};
+    return find(path, stamp);
+}
+
+MetadataIndex::Metadata MetadataIndex::get(const QString& path) {
+    Stamp stamp{};
+    if (auto metadata = find(path, stamp)) {
+        return *metadata;
+    }
+
+    // Images named as such only need their header read for the dimensions, anything else or anything whose header
+    // can't be read is sniffed
+    auto metadata = guess(path).value_or(Metadata{});
+    if (metadata.isImage) {
+        metadata.imageSize = QImageReader(path).size();
+    }
+    if (!metadata.imageSize.isValid()) {
+        metadata = sniff(path);
+    }
+    metadata.size = stamp.size;
+    record(path, stamp, metadata);
+    return metadata;
+}
+
+std::optional<MetadataIndex::Metadata> MetadataIndex::find(const QString& path, Stamp& stamp) {
+    struct stat st;
+    if (stat(QFile::encodeName(path).constData(), &st) != 0) {
+        // Nothing to read either
+        return Metadata{};
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        return Metadata{ QStringLiteral("inode/directory"), {}, st.st_size, false };
+    }
+
+    stamp = { st.st_ino, st.st_mtim.tv_sec * 1'000'000'000 + st.st_mtim.tv_nsec, st.st_size };
+
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_fresh.constFind(path);
+        if (it != m_fresh.constEnd() && it->stamp == stamp) {
+            return it->metadata;
+        }
+    }
+
+    if (auto mapped = findMapped(path.toUtf8(), stamp)) {
+        return mapped;
+    }
+
+    // Images still need their dimensions from the header, which is left to get so they are never recorded without
+    if (auto guessed = guess(path); guessed && !guessed->isImage) {
+        guessed->size = st.st_size;
+        record(path, stamp, *guessed);
+        return guessed;
+    }
+
+    return std::nullopt;
+}
+
+void MetadataIndex::record(const QString& path, const Stamp& stamp, const Metadata& metadata) {
+    {
+        QMutexLocker locker(&m_mutex);
+        m_fresh.insert(path, { stamp, metadata });
+    }
+    requestSave();
+}
+
+void MetadataIndex::load() {
+    m_file.setFileName(m_path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const auto size = static_cast<quint64>(m_file.size());
+    uchar* const map = size >= sizeof(FileHeader) ? m_file.map(0, m_file.size()) : nullptr;
+    if (!map) {
+        m_file.close();
+        return;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, map, sizeof(header));
+
+    const auto recordsEnd = sizeof(FileHeader) + static_cast<quint64>(header.count) * sizeof(FileRecord);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || recordsEnd > size ||
+        header.stringsOffset < recordsEnd || header.stringsSize > size - header.stringsOffset) {
+        qCWarning(lcMetadataIndex) << "load: ignoring invalid index" << m_path;
+        m_file.unmap(map);
+        m_file.close();
+        return;
+    }
+
+    m_records = map + sizeof(FileHeader);
+    m_count = header.count;
+    m_strings = reinterpret_cast<const char*>(map + header.stringsOffset);
+    m_stringsSize = header.stringsSize;
+
+    qCDebug(lcMetadataIndex) << "load: mapped" << m_count << "records from" << m_path;
+}
+
+void MetadataIndex::requestSave() {
+    m_dirty = true;
+
+    // Lookups happen on worker threads, the timer lives on this object's
+    if (!m_saveQueued.exchange(true)) {
+        QMetaObject::invokeMethod(
+            this,
+            [this]() {
+                m_saveTimer.start();
+            },
+            Qt::QueuedConnection);
+    }
+}
+
+void MetadataIndex::save() {
+    QMutexLocker saveLocker(&m_saveMutex);
+
+    if (!m_dirty.exchange(false)) {
+        return;
+    }
+
+    QHash<QString, Record> fresh;
+    {
+        QMutexLocker locker(&m_mutex);
+        fresh = m_fresh;
+    }
+
+    struct Entry {
+        FileRecord record;
+        QByteArray path;
+        QByteArray mime;
+    };
+
+    std::vector<Entry> entries;
+    entries.reserve(static_cast<size_t>(fresh.size()) + m_count);
+
+    for (auto it = fresh.cbegin(); it != fresh.cend(); ++it) {
+        const auto& [stamp, metadata] = it.value();
+
+        Entry entry{};
+        entry.path = it.key().toUtf8();
+        entry.mime = metadata.mimeType.toUtf8();
+        entry.record.hash = hashPath(entry.path);
+        entry.record.inode = stamp.inode;
+        entry.record.mtime = stamp.mtime;
+        entry.record.size = stamp.size;
+        entry.record.width = metadata.imageSize.width();
+        entry.record.height = metadata.imageSize.height();
+        entry.record.flags = metadata.isImage ? FLAG_IMAGE : 0;
+        entries.push_back(std::move(entry));
+    }
+
+    // Keep everything from the last save that hasn't been probed again since
+    const auto* const records = reinterpret_cast<const FileRecord*>(m_records);
+    for (quint32 i = 0; i < m_count && entries.size() < MAX_RECORDS; ++i) {
+        const auto& record = records[i];
+        if (static_cast<quint64>(record.pathOffset) + record.pathLength > m_stringsSize ||
+            static_cast<quint64>(record.mimeOffset) + record.mimeLength > m_stringsSize) {
+            continue;
+        }
+
+        const QByteArray path(m_strings + record.pathOffset, record.pathLength);
+        if (fresh.contains(QString::fromUtf8(path))) {
+            continue;
+        }
+
+        entries.push_back({ record, path, QByteArray(m_strings + record.mimeOffset, record.mimeLength) });
+    }
+
+    if (entries.size() > MAX_RECORDS) {
+        entries.resize(MAX_RECORDS);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.record.hash < b.record.hash;
+    });
+
+    // Paths are unique but there are only a handful of mime types
+    QByteArray strings;
+    QHash<QByteArray, quint32> mimeOffsets;
+    for (auto& entry : entries) {
+        entry.record.pathOffset = static_cast<quint32>(strings.size());
+        entry.record.pathLength = static_cast<quint32>(entry.path.size());
+        strings += entry.path;
+
+        auto it = mimeOffsets.constFind(entry.mime);
+        if (it == mimeOffsets.constEnd()) {
+            it = mimeOffsets.insert(entry.mime, static_cast<quint32>(strings.size()));
+            strings += entry.mime;
+        }
+        entry.record.mimeOffset = *it;
+        entry.record.mimeLength = static_cast<quint32>(entry.mime.size());
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.count = static_cast<quint32>(entries.size());
+    header.stringsOffset = sizeof(FileHeader) + entries.size() * sizeof(FileRecord);
+    header.stringsSize = static_cast<quint64>(strings.size());
+
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+
+    // Replaced atomically, the old file stays mapped and valid until exit
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcMetadataIndex) << "save: failed to open" << m_path << "-" << file.errorString();
+        return;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& entry : entries) {
+        file.write(reinterpret_cast<const char*>(&entry.record), sizeof(FileRecord));
+    }
+    file.write(strings);
+
+    if (!file.commit()) {
+        qCWarning(lcMetadataIndex) << "save: failed to write" << m_path << "-" << file.errorString();
+        return;
+    }
+
+    qCDebug(lcMetadataIndex) << "save: wrote" << entries.size() << "records to" << m_path;
+}
+
+std::optional<MetadataIndex::Metadata> MetadataIndex::findMapped(const QByteArray& path, const Stamp& stamp) const {
+    if (!m_records) {
+        return std::nullopt;
+    }
+
+    const auto* const begin = reinterpret_cast<const FileRecord*>(m_records);
+    const auto* const end = begin + m_count;
+    const auto hash = hashPath(path);
+
+    auto it = std::lower_bound(begin, end, hash, [](const FileRecord& record, quint64 h) {
+        return record.hash < h;
+    });
+    for (; it != end && it->hash == hash; ++it) {
+        if (static_cast<quint64>(it->pathOffset) + it->pathLength > m_stringsSize ||
+            static_cast<quint64>(it->mimeOffset) + it->mimeLength > m_stringsSize) {
+            continue;
+        }
+        if (QByteArrayView(m_strings + it->pathOffset, it->pathLength) != path) {
+            continue;
+        }
+
+        if (it->inode != stamp.inode || it->mtime != stamp.mtime || it->size != stamp.size) {
+            return std::nullopt;
+        }
+
+        Metadata metadata;
+        metadata.mimeType = QString::fromUtf8(m_strings + it->mimeOffset, it->mimeLength);
+        metadata.isImage = it->flags & FLAG_IMAGE;
+        if (metadata.isImage) {
+            metadata.imageSize = QSize(it->width, it->height);
+        }
+        metadata.size = it->size;
+        return metadata;
+    }
+
+    return std::nullopt;
+}
+
+} // namespace caelestia::models
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <qfile.h>
+#include <qhash.h>
+#include <qmutex.h>
+#include <qobject.h>
+#include <qsize.h>
+#include <qtimer.h>
+
+namespace caelestia::models {
+
+// Persistent cache of what's inside files, so a known file costs a stat instead of opening it. The index on disk
+// is mapped and searched in place, anything probed since it was loaded is kept on the side until the next save.
+class MetadataIndex : public QObject {
+    Q_OBJECT
+
+public:
+    struct Metadata {
+        QString mimeType;
+        QSize imageSize; // invalid unless isImage
+        qint64 size = 0;
+        bool isImage = false;
+    };
+
+    // Must first be called from the main thread
+    static MetadataIndex& instance();
+
+    // Everything here is safe to call from any thread
+
+    // What's known without reading the file, either recorded while it was unchanged or guessed from a name that
+    // only matches one mime type. Empty if only the contents can tell, which includes the dimensions of new images.
+    [[nodiscard]] std::optional<Metadata> find(const QString& path);
+
+    // Same as find, but falls back to reading the file and records the result
+    [[nodiscard]] Metadata get(const QString& path);
+
+private:
+    // Identifies a version of a file without reading it
+    struct Stamp {
+        quint64 inode;
+        qint64 mtime; // ns
+        qint64 size;
+
+        bool operator==(const Stamp&) const = default;
+    };
+
+    struct Record {
+        Stamp stamp;
+        Metadata metadata;
+    };
+
+    explicit MetadataIndex();
+
+    QString m_path;
+    QFile m_file;
+    const uchar* m_records;
+    quint32 m_count;
+    const char* m_strings;
+    quint64 m_stringsSize;
+
+    QMutex m_mutex;
+    QHash<QString, Record> m_fresh; // probed since load, wins over the mapped index
+
+    QMutex m_saveMutex;
+    std::atomic<bool> m_dirty;
+    std::atomic<bool> m_saveQueued;
+    QTimer m_saveTimer;
+
+    [[nodiscard]] std::optional<Metadata> find(const QString& path, Stamp& stamp);
+    void record(const QString& path, const Stamp& stamp, const Metadata& metadata);
+    void load();
+    void requestSave();
+    void save();
+    [[nodiscard]] std::optional<Metadata> findMapped(const QByteArray& path, const Stamp& stamp) const;
+};
+
+} // namespace caelestia::models
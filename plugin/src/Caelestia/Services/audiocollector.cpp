@@ -1,13 +1,18 @@
 #include "audiocollector.hpp"
 
+#include "audioringbuffer.hpp"
+#include "dsp.hpp"
 #include "service.hpp"
 #include <algorithm>
+#include <atomic>
 #include <pipewire/pipewire.h>
 #include <qloggingcategory.h>
 #include <qmutex.h>
 #include <spa/param/audio/format-utils.h>
 #include <spa/param/latency-utils.h>
 #include <stop_token>
+#include <sys/eventfd.h>
+#include <thread>
 #include <vector>
 
 Q_LOGGING_CATEGORY(lcAc, "caelestia.services.ac", QtInfoMsg)
@@ -15,11 +20,23 @@ Q_LOGGING_CATEGORY(lcAcWorker, "caelestia.services.ac.worker", QtInfoMsg)
 
 namespace caelestia::services {
 
+namespace {
+
+// Format in the high half, channels in the low. Formats all fit in 16 bits and channels are capped well below.
+quint32 packLayout(spa_audio_format format, quint32 channels) {
+    return (static_cast<quint32>(format) << 16) | std::min(channels, 0xffffu);
+}
+
+} // namespace
+
 PipeWireWorker::PipeWireWorker(std::stop_token token, AudioCollector* collector)
     : m_loop(nullptr)
     , m_stream(nullptr)
     , m_timer(nullptr)
     , m_idle(true)
+    , m_silentTicks(0)
+    , m_layout(packLayout(SPA_AUDIO_FORMAT_F32, 1))
+    , m_mixBuffer(ac::BUFFER_SIZE)
     , m_token(token)
     , m_collector(collector) {
     pw_init(nullptr, nullptr);
@@ -45,7 +62,8 @@ PipeWireWorker::PipeWireWorker(std::stop_token token, AudioCollector* collector)
         PW_KEY_MEDIA_TYPE, "Audio", PW_KEY_MEDIA_CATEGORY, "Capture", PW_KEY_MEDIA_ROLE, "Music", nullptr);
     pw_properties_set(props, PW_KEY_STREAM_CAPTURE_SINK, "true");
     pw_properties_setf(
-        props, PW_KEY_NODE_LATENCY, "%u/%u", nextPowerOf2(512 * ac::SAMPLE_RATE / 48000), ac::SAMPLE_RATE);
+        props, PW_KEY_NODE_LATENCY, "%u/%u", nextPowerOf2(512 * ac::DEFAULT_SAMPLE_RATE / 48000),
+        ac::DEFAULT_SAMPLE_RATE);
     pw_properties_set(props, PW_KEY_NODE_PASSIVE, "true");
     pw_properties_set(props, PW_KEY_NODE_VIRTUAL, "true");
     pw_properties_set(props, PW_KEY_STREAM_DONT_REMIX, "false");
@@ -55,13 +73,19 @@ PipeWireWorker::PipeWireWorker(std::stop_token token, AudioCollector* collector)
     spa_pod_builder b;
     spa_pod_builder_init(&b, buffer.data(), static_cast<quint32>(buffer.size()));
 
+    // Prefer the graph's native float format, rate and channels so PipeWire doesn't need to convert.
+    // Rate and channels are left unset to accept whatever the graph runs at.
     spa_audio_info_raw info{};
-    info.format = SPA_AUDIO_FORMAT_S16;
-    info.rate = ac::SAMPLE_RATE;
-    info.channels = 1;
+    info.format = SPA_AUDIO_FORMAT_F32;
 
-    const spa_pod* params[1];
+    // Fall back to mono S16, still at the native rate
+    spa_audio_info_raw fallback{};
+    fallback.format = SPA_AUDIO_FORMAT_S16;
+    fallback.channels = 1;
+
+    const spa_pod* params[2];
     params[0] = spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat, &info);
+    params[1] = spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat, &fallback);
 
     pw_stream_events events{};
     events.version = PW_VERSION_STREAM_EVENTS;
@@ -69,6 +93,10 @@ PipeWireWorker::PipeWireWorker(std::stop_token token, AudioCollector* collector)
         auto* self = static_cast<PipeWireWorker*>(data);
         self->streamStateChanged(state);
     };
+    events.param_changed = [](void* data, quint32 id, const spa_pod* param) {
+        auto* self = static_cast<PipeWireWorker*>(data);
+        self->streamParamChanged(id, param);
+    };
     events.process = [](void* data) {
         auto* self = static_cast<PipeWireWorker*>(data);
         self->processStream();
@@ -85,7 +113,7 @@ PipeWireWorker::PipeWireWorker(std::stop_token token, AudioCollector* collector)
     const int success = pw_stream_connect(m_stream, PW_DIRECTION_INPUT, PW_ID_ANY,
         static_cast<pw_stream_flags>(
             PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS | PW_STREAM_FLAG_RT_PROCESS),
-        params, 1);
+        params, 2);
     if (success < 0) {
         qCWarning(lcAcWorker) << "init: failed to connect stream";
         pw_stream_destroy(m_stream);
@@ -110,7 +138,9 @@ void PipeWireWorker::handleTimeout(void* data, uint64_t expirations) {
     }
 
     if (!self->m_idle) {
-        if (expirations < 10) {
+        // Feed silence for long enough to let consumers settle, then stop waking them
+        self->m_silentTicks += expirations;
+        if (self->m_silentTicks < ac::SILENT_TICKS) {
             self->m_collector->clearBuffer();
         } else {
             self->m_idle = true;
@@ -122,6 +152,7 @@ void PipeWireWorker::handleTimeout(void* data, uint64_t expirations) {
 
 void PipeWireWorker::streamStateChanged(pw_stream_state state) {
     m_idle = false;
+    m_silentTicks = 0;
     switch (state) {
     case PW_STREAM_STATE_PAUSED: {
         timespec timeout = { 0, 10 * SPA_NSEC_PER_MSEC };
@@ -139,6 +170,34 @@ void PipeWireWorker::streamStateChanged(pw_stream_state state) {
     }
 }
 
+void PipeWireWorker::streamParamChanged(quint32 id, const spa_pod* param) {
+    if (param == nullptr || id != SPA_PARAM_Format) {
+        return;
+    }
+
+    quint32 mediaType;
+    quint32 mediaSubtype;
+    if (spa_format_parse(param, &mediaType, &mediaSubtype) < 0 || mediaType != SPA_MEDIA_TYPE_audio ||
+        mediaSubtype != SPA_MEDIA_SUBTYPE_raw) {
+        return;
+    }
+
+    spa_audio_info_raw info{};
+    if (spa_format_audio_raw_parse(param, &info) < 0) {
+        qCWarning(lcAcWorker) << "streamParamChanged: failed to parse audio format";
+        return;
+    }
+
+    const quint32 channels = std::max(info.channels, 1u);
+    m_layout.store(packLayout(info.format, channels), std::memory_order_release);
+    qCDebug(lcAcWorker) << "streamParamChanged: negotiated format" << info.format << "rate" << info.rate << "channels"
+                        << channels;
+
+    if (info.rate > 0) {
+        m_collector->setSampleRate(info.rate);
+    }
+}
+
 void PipeWireWorker::processStream() {
     if (m_token.stop_requested()) {
         pw_main_loop_quit(m_loop);
@@ -151,17 +210,54 @@ void PipeWireWorker::processStream() {
     }
 
     const spa_buffer* buf = buffer->buffer;
-    const qint16* samples = reinterpret_cast<const qint16*>(buf->datas[0].data);
-    if (samples == nullptr) {
+    const void* data = buf->datas[0].data;
+    if (data == nullptr) {
+        pw_stream_queue_buffer(m_stream, buffer);
         return;
     }
 
-    const quint32 count = buf->datas[0].chunk->size / 2;
-    m_collector->loadChunk(samples, count);
+    // Loaded once so a renegotiation mid buffer can't pair one format with another's channel count
+    const quint32 layout = m_layout.load(std::memory_order_acquire);
+    const auto format = static_cast<spa_audio_format>(layout >> 16);
+    const quint32 channels = layout & 0xffffu;
+
+    const quint32 size = buf->datas[0].chunk->size;
+    if (format == SPA_AUDIO_FORMAT_S16) {
+        m_collector->loadChunk(static_cast<const qint16*>(data), size / 2);
+    } else if (channels == 1) {
+        m_collector->loadChunk(static_cast<const float*>(data), size / 4);
+    } else {
+        // Only the newest frames fit in the ring buffer anyways
+        quint32 frames = size / (4 * channels);
+        const auto* samples = static_cast<const float*>(data);
+        if (frames > m_mixBuffer.size()) {
+            samples += (frames - m_mixBuffer.size()) * channels;
+            frames = static_cast<quint32>(m_mixBuffer.size());
+        }
+
+        downmix(samples, m_mixBuffer.data(), frames, channels);
+        m_collector->loadChunk(m_mixBuffer.data(), frames);
+    }
 
     pw_stream_queue_buffer(m_stream, buffer);
 }
 
+void PipeWireWorker::downmix(const float* in, float* out, quint32 frames, quint32 channels) {
+    if (channels == 2) {
+        dsp::stereoToMono(in, out, frames);
+        return;
+    }
+
+    for (quint32 i = 0; i < frames; ++i) {
+        float sum = 0.0f;
+        for (quint32 c = 0; c < channels; ++c) {
+            sum += in[i * channels + c];
+        }
+        out[i] = sum;
+    }
+    dsp::gain(out, frames, 1.0f / static_cast<float>(channels));
+}
+
 unsigned int PipeWireWorker::nextPowerOf2(unsigned int n) {
     if (n == 0) {
         return 1;
@@ -183,58 +279,99 @@ AudioCollector& AudioCollector::instance() {
     return instance;
 }
 
-void AudioCollector::clearBuffer() {
-    auto* writeBuffer = m_writeBuffer.load(std::memory_order_relaxed);
-    std::fill(writeBuffer->begin(), writeBuffer->end(), 0.0f);
-
-    auto* oldRead = m_readBuffer.exchange(writeBuffer, std::memory_order_acq_rel);
-    m_writeBuffer.store(oldRead, std::memory_order_release);
+quint32 AudioCollector::sampleRate() const {
+    return m_sampleRate.load(std::memory_order_relaxed);
 }
 
-void AudioCollector::loadChunk(const qint16* samples, quint32 count) {
-    if (count > ac::CHUNK_SIZE) {
-        count = ac::CHUNK_SIZE;
+void AudioCollector::setSampleRate(quint32 rate) {
+    if (m_sampleRate.exchange(rate, std::memory_order_relaxed) != rate) {
+        emit sampleRateChanged(rate);
     }
+}
 
-    auto* writeBuffer = m_writeBuffer.load(std::memory_order_relaxed);
-    std::transform(samples, samples + count, writeBuffer->begin(), [](qint16 sample) {
-        return sample / 32768.0f;
-    });
+quint64 AudioCollector::droppedSamples() const {
+    return m_buffer.dropped();
+}
+
+quint64 AudioCollector::overrunSamples() const {
+    return m_buffer.overruns();
+}
+
+void AudioCollector::clearBuffer() {
+    m_buffer.fill(0.0f, ac::CHUNK_SIZE);
+    notifyListeners();
+}
+
+void AudioCollector::loadChunk(const qint16* samples, quint32 count) {
+    m_buffer.write(samples, count);
+    notifyListeners();
+}
 
-    auto* oldRead = m_readBuffer.exchange(writeBuffer, std::memory_order_acq_rel);
-    m_writeBuffer.store(oldRead, std::memory_order_release);
+void AudioCollector::loadChunk(const float* samples, quint32 count) {
+    m_buffer.write(samples, count);
+    notifyListeners();
 }
 
-quint32 AudioCollector::readChunk(float* out, quint32 count) {
-    if (count == 0 || count > ac::CHUNK_SIZE) {
-        count = ac::CHUNK_SIZE;
+bool AudioCollector::addListener(int fd) {
+    for (auto& listener : m_listeners) {
+        int expected = -1;
+        if (listener.compare_exchange_strong(expected, fd)) {
+            return true;
+        }
     }
 
-    auto* readBuffer = m_readBuffer.load(std::memory_order_acquire);
-    std::memcpy(out, readBuffer->data(), count * sizeof(float));
+    qCWarning(lcAc) << "addListener: too many listeners, max is" << ac::MAX_LISTENERS;
+    return false;
+}
+
+void AudioCollector::removeListener(int fd) {
+    for (auto& listener : m_listeners) {
+        int expected = fd;
+        listener.compare_exchange_strong(expected, -1);
+    }
 
-    return count;
+    // Wait for any in flight notification so the caller can safely close the fd
+    while (m_notifying.load() > 0) {
+        std::this_thread::yield();
+    }
 }
 
-quint32 AudioCollector::readChunk(double* out, quint32 count) {
-    if (count == 0 || count > ac::CHUNK_SIZE) {
-        count = ac::CHUNK_SIZE;
+void AudioCollector::notifyListeners() {
+    m_notifying.fetch_add(1);
+    for (const auto& listener : m_listeners) {
+        const int fd = listener.load();
+        if (fd >= 0) {
+            eventfd_write(fd, 1);
+        }
     }
+    m_notifying.fetch_sub(1);
+}
 
-    auto* readBuffer = m_readBuffer.load(std::memory_order_acquire);
-    std::transform(readBuffer->begin(), readBuffer->begin() + count, out, [](float sample) {
-        return static_cast<double>(sample);
-    });
+AudioRingBuffer::Cursor AudioCollector::cursor() const {
+    return m_buffer.cursor();
+}
+
+quint32 AudioCollector::available(const AudioRingBuffer::Cursor& cursor) const {
+    return m_buffer.available(cursor);
+}
 
-    return count;
+quint32 AudioCollector::readChunk(AudioRingBuffer::Cursor& cursor, float* out, quint32 count) {
+    return m_buffer.read(cursor, out, count);
+}
+
+quint32 AudioCollector::readChunk(AudioRingBuffer::Cursor& cursor, double* out, quint32 count) {
+    return m_buffer.read(cursor, out, count);
 }
 
 AudioCollector::AudioCollector(QObject* parent)
     : Service(parent)
-    , m_buffer1(ac::CHUNK_SIZE)
-    , m_buffer2(ac::CHUNK_SIZE)
-    , m_readBuffer(&m_buffer1)
-    , m_writeBuffer(&m_buffer2) {}
+    , m_buffer(ac::BUFFER_SIZE)
+    , m_sampleRate(ac::DEFAULT_SAMPLE_RATE)
+    , m_notifying(0) {
+    for (auto& listener : m_listeners) {
+        listener.store(-1, std::memory_order_relaxed);
+    }
+}
 
 AudioCollector::~AudioCollector() {
     AudioCollector::stop();
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "audioringbuffer.hpp"
 #include "service.hpp"
+#include <array>
 #include <atomic>
 #include <pipewire/pipewire.h>
 #include <qmutex.h>
@@ -14,8 +16,11 @@ namespace caelestia::services {
 
 namespace ac {
 
-constexpr quint32 SAMPLE_RATE = 44100;
+constexpr quint32 DEFAULT_SAMPLE_RATE = 48000;
 constexpr quint32 CHUNK_SIZE = 512;
+constexpr quint32 BUFFER_SIZE = 16384;
+constexpr quint32 MAX_LISTENERS = 8;
+constexpr quint64 SILENT_TICKS = 100;
 
 } // namespace ac
 
@@ -32,13 +37,21 @@ private:
     pw_stream* m_stream;
     spa_source* m_timer;
     bool m_idle;
+    quint64 m_silentTicks;
+
+    // Negotiated on the main loop but read by process on the data thread, so the format and channel count are packed
+    // into one word to be swapped together, see packLayout
+    std::atomic<quint32> m_layout;
+    std::vector<float> m_mixBuffer;
 
     std::stop_token m_token;
     AudioCollector* m_collector;
 
     static void handleTimeout(void* data, uint64_t expirations);
     void streamStateChanged(pw_stream_state state);
+    void streamParamChanged(quint32 id, const spa_pod* param);
     void processStream();
+    static void downmix(const float* in, float* out, quint32 frames, quint32 channels);
 
     [[nodiscard]] unsigned int nextPowerOf2(unsigned int n);
 };
@@ -52,21 +65,38 @@ public:
 
     static AudioCollector& instance();
 
+    [[nodiscard]] quint32 sampleRate() const;
+    void setSampleRate(quint32 rate);
+
+    [[nodiscard]] quint64 droppedSamples() const;
+    [[nodiscard]] quint64 overrunSamples() const;
+
     void clearBuffer();
     void loadChunk(const qint16* samples, quint32 count);
-    quint32 readChunk(float* out, quint32 count = 0);
-    quint32 readChunk(double* out, quint32 count = 0);
+    void loadChunk(const float* samples, quint32 count);
+
+    bool addListener(int fd);
+    void removeListener(int fd);
+
+    [[nodiscard]] AudioRingBuffer::Cursor cursor() const;
+    [[nodiscard]] quint32 available(const AudioRingBuffer::Cursor& cursor) const;
+    quint32 readChunk(AudioRingBuffer::Cursor& cursor, float* out, quint32 count = ac::CHUNK_SIZE);
+    quint32 readChunk(AudioRingBuffer::Cursor& cursor, double* out, quint32 count = ac::CHUNK_SIZE);
+
+signals:
+    void sampleRateChanged(quint32 rate);
 
 private:
     explicit AudioCollector(QObject* parent = nullptr);
     ~AudioCollector();
 
     std::jthread m_thread;
-    std::vector<float> m_buffer1;
-    std::vector<float> m_buffer2;
-    std::atomic<std::vector<float>*> m_readBuffer;
-    std::atomic<std::vector<float>*> m_writeBuffer;
-    quint32 m_sampleCount;
+    AudioRingBuffer m_buffer;
+    std::atomic<quint32> m_sampleRate;
+    std::array<std::atomic<int>, ac::MAX_LISTENERS> m_listeners;
+    std::atomic<int> m_notifying;
+
+    void notifyListeners();
 
     void reload();
     void start() override;
@@ -2,8 +2,12 @@
 
 #include "audiocollector.hpp"
 #include "service.hpp"
+#include <cerrno>
+#include <cstring>
 #include <qloggingcategory.h>
 #include <qthread.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 Q_LOGGING_CATEGORY(lcAp, "caelestia.services.ap", QtInfoMsg)
 Q_LOGGING_CATEGORY(lcApProcessor, "caelestia.services.ap.processor", QtInfoMsg)
@@ -11,32 +15,97 @@ Q_LOGGING_CATEGORY(lcApProcessor, "caelestia.services.ap.processor", QtInfoMsg)
 namespace caelestia::services {
 
 AudioProcessor::AudioProcessor(QObject* parent)
-    : QObject(parent) {}
+    : QObject(parent)
+    , m_sampleRate(ac::DEFAULT_SAMPLE_RATE) {}
 
 AudioProcessor::~AudioProcessor() {
     stop();
+    if (m_eventFd >= 0) {
+        close(m_eventFd);
+    }
 }
 
 void AudioProcessor::init() {
-    m_timer = new QTimer(this);
-    m_timer->setInterval(static_cast<int>(ac::CHUNK_SIZE * 1000.0 / ac::SAMPLE_RATE));
-    connect(m_timer, &QTimer::timeout, this, &AudioProcessor::process);
+    m_eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_eventFd < 0) {
+        qCWarning(lcApProcessor) << "init: failed to create eventfd:" << strerror(errno);
+        return;
+    }
+
+    m_notifier = new QSocketNotifier(m_eventFd, QSocketNotifier::Read, this);
+    m_notifier->setEnabled(false);
+    connect(m_notifier, &QSocketNotifier::activated, this, &AudioProcessor::handleNotify);
+
+    connect(&AudioCollector::instance(), &AudioCollector::sampleRateChanged, this, &AudioProcessor::setSampleRate);
 }
 
 void AudioProcessor::start() {
     QMetaObject::invokeMethod(&AudioCollector::instance(), &AudioCollector::ref, Qt::QueuedConnection, this);
-    if (m_timer) {
-        m_timer->start();
+    m_cursor = AudioCollector::instance().cursor();
+    setSampleRate(AudioCollector::instance().sampleRate());
+    if (m_notifier && !m_listening) {
+        m_listening = AudioCollector::instance().addListener(m_eventFd);
+        m_notifier->setEnabled(m_listening);
     }
 }
 
 void AudioProcessor::stop() {
-    if (m_timer) {
-        m_timer->stop();
+    if (m_listening) {
+        AudioCollector::instance().removeListener(m_eventFd);
+        m_notifier->setEnabled(false);
+        m_listening = false;
     }
     QMetaObject::invokeMethod(&AudioCollector::instance(), &AudioCollector::unref, Qt::QueuedConnection, this);
 }
 
+void AudioProcessor::handleNotify() {
+    // Reset the counter, multiple quanta may have landed since the last wake and process() drains them all
+    eventfd_t value;
+    eventfd_read(m_eventFd, &value);
+
+    process();
+}
+
+void AudioProcessor::setSampleRate(quint32 rate) {
+    if (m_sampleRate == rate) {
+        return;
+    }
+
+    qCDebug(lcApProcessor) << "setSampleRate: sample rate changed to" << rate;
+    m_sampleRate = rate;
+    reload();
+}
+
+quint32 AudioProcessor::sampleRate() const {
+    return m_sampleRate;
+}
+
+quint32 AudioProcessor::available() const {
+    return AudioCollector::instance().available(m_cursor);
+}
+
+quint32 AudioProcessor::readChunk(float* out, quint32 count) {
+    const quint64 overruns = m_cursor.overruns;
+    const quint32 read = AudioCollector::instance().readChunk(m_cursor, out, count);
+    checkOverruns(overruns);
+    return read;
+}
+
+quint32 AudioProcessor::readChunk(double* out, quint32 count) {
+    const quint64 overruns = m_cursor.overruns;
+    const quint32 read = AudioCollector::instance().readChunk(m_cursor, out, count);
+    checkOverruns(overruns);
+    return read;
+}
+
+void AudioProcessor::checkOverruns(quint64 previous) const {
+    if (m_cursor.overruns != previous) {
+        const auto& collector = AudioCollector::instance();
+        qCDebug(lcApProcessor) << "readChunk: lost" << m_cursor.overruns - previous << "samples (total overruns"
+                               << collector.overrunSamples() << "dropped" << collector.droppedSamples() << ")";
+    }
+}
+
 AudioProvider::AudioProvider(QObject* parent)
     : Service(parent)
     , m_processor(nullptr)
@@ -1,8 +1,9 @@
 #pragma once
 
+#include "audioringbuffer.hpp"
 #include "service.hpp"
 #include <qqmlintegration.h>
-#include <qtimer.h>
+#include <qsocketnotifier.h>
 
 namespace caelestia::services {
 
@@ -21,9 +22,24 @@ public slots:
 
 protected:
     virtual void process() = 0;
+    virtual void reload() {}
+
+    [[nodiscard]] quint32 sampleRate() const;
+    [[nodiscard]] quint32 available() const;
+    quint32 readChunk(float* out, quint32 count);
+    quint32 readChunk(double* out, quint32 count);
 
 private:
-    QTimer* m_timer = nullptr;
+    QSocketNotifier* m_notifier = nullptr;
+    int m_eventFd = -1;
+    bool m_listening = false;
+    quint32 m_sampleRate;
+    AudioRingBuffer::Cursor m_cursor;
+
+    void handleNotify();
+    void setSampleRate(quint32 rate);
+
+    void checkOverruns(quint64 previous) const;
 };
 
 class AudioProvider : public Service {
@@ -0,0 +1,153 @@
+#include "audioringbuffer.hpp"
+
+#include "dsp.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace caelestia::services {
+
+namespace {
+
+quint32 roundUpPow2(quint32 n) {
+    quint32 pow = 1;
+    while (pow < n) {
+        pow <<= 1;
+    }
+    return pow;
+}
+
+void copyOut(const float* in, float* out, quint32 count) {
+    std::memcpy(out, in, count * sizeof(float));
+}
+
+void copyOut(const float* in, double* out, quint32 count) {
+    dsp::f32ToF64(in, out, count);
+}
+
+} // namespace
+
+AudioRingBuffer::AudioRingBuffer(quint32 capacity)
+    : m_data(roundUpPow2(capacity))
+    , m_mask(m_data.size() - 1)
+    , m_claim(0)
+    , m_head(0)
+    , m_dropped(0)
+    , m_overruns(0) {}
+
+quint32 AudioRingBuffer::capacity() const {
+    return static_cast<quint32>(m_data.size());
+}
+
+quint64 AudioRingBuffer::dropped() const {
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+quint64 AudioRingBuffer::overruns() const {
+    return m_overruns.load(std::memory_order_relaxed);
+}
+
+template <typename F> void AudioRingBuffer::produce(quint32 count, F&& copy) {
+    quint32 offset = 0;
+    if (count > capacity()) {
+        // Only the newest capacity samples can ever be read
+        offset = count - capacity();
+        m_dropped.fetch_add(offset, std::memory_order_relaxed);
+        count = capacity();
+    }
+
+    if (count == 0) {
+        return;
+    }
+
+    const quint64 head = m_head.load(std::memory_order_relaxed);
+
+    // Announce the overwritten range before touching it so readers can detect torn copies
+    m_claim.store(head + count, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const auto start = static_cast<quint32>(head & m_mask);
+    const quint32 first = std::min(count, capacity() - start);
+    copy(m_data.data() + start, offset, first);
+    if (first < count) {
+        copy(m_data.data(), offset + first, count - first);
+    }
+
+    m_head.store(head + count, std::memory_order_release);
+}
+
+void AudioRingBuffer::write(const float* samples, quint32 count) {
+    produce(count, [samples](float* dst, quint32 src, quint32 n) {
+        std::memcpy(dst, samples + src, n * sizeof(float));
+    });
+}
+
+void AudioRingBuffer::write(const qint16* samples, quint32 count) {
+    produce(count, [samples](float* dst, quint32 src, quint32 n) {
+        dsp::s16ToF32(samples + src, dst, n);
+    });
+}
+
+void AudioRingBuffer::fill(float value, quint32 count) {
+    produce(count, [value](float* dst, quint32, quint32 n) {
+        std::fill_n(dst, n, value);
+    });
+}
+
+AudioRingBuffer::Cursor AudioRingBuffer::cursor() const {
+    return { m_head.load(std::memory_order_acquire), 0 };
+}
+
+quint32 AudioRingBuffer::available(const Cursor& cursor) const {
+    const quint64 head = m_head.load(std::memory_order_acquire);
+    return static_cast<quint32>(std::min<quint64>(head - cursor.pos, capacity()));
+}
+
+template <typename T> quint32 AudioRingBuffer::consume(Cursor& cursor, T* out, quint32 count) {
+    for (;;) {
+        const quint64 head = m_head.load(std::memory_order_acquire);
+
+        if (head - cursor.pos > capacity()) {
+            const quint64 lost = head - capacity() - cursor.pos;
+            cursor.pos += lost;
+            cursor.overruns += lost;
+            m_overruns.fetch_add(lost, std::memory_order_relaxed);
+        }
+
+        const auto n = static_cast<quint32>(std::min<quint64>(count, head - cursor.pos));
+        if (n == 0) {
+            return 0;
+        }
+
+        const auto start = static_cast<quint32>(cursor.pos & m_mask);
+        const quint32 first = std::min(n, capacity() - start);
+        copyOut(m_data.data() + start, out, first);
+        if (first < n) {
+            copyOut(m_data.data(), out + first, n - first);
+        }
+
+        // If the producer claimed any slot we copied from, the copy may be torn so retry past it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const quint64 claim = m_claim.load(std::memory_order_relaxed);
+        if (claim - cursor.pos > capacity()) {
+            const quint64 lost = claim - capacity() - cursor.pos;
+            cursor.pos += lost;
+            cursor.overruns += lost;
+            m_overruns.fetch_add(lost, std::memory_order_relaxed);
+            continue;
+        }
+
+        cursor.pos += n;
+        return n;
+    }
+}
+
+quint32 AudioRingBuffer::read(Cursor& cursor, float* out, quint32 count) {
+    return consume(cursor, out, count);
+}
+
+quint32 AudioRingBuffer::read(Cursor& cursor, double* out, quint32 count) {
+    return consume(cursor, out, count);
+}
+
+} // namespace caelestia::services
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <qtypes.h>
+#include <vector>
+
+namespace caelestia::services {
+
+// Single producer, multi consumer broadcast ring buffer for audio samples.
+// The producer never blocks; a consumer that falls more than a capacity behind
+// loses the oldest samples, which are counted as overruns.
+class AudioRingBuffer {
+public:
+    struct Cursor {
+        quint64 pos = 0;
+        quint64 overruns = 0;
+    };
+
+    explicit AudioRingBuffer(quint32 capacity);
+
+    AudioRingBuffer(const AudioRingBuffer&) = delete;
+    AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+    [[nodiscard]] quint32 capacity() const;
+    [[nodiscard]] quint64 dropped() const;
+    [[nodiscard]] quint64 overruns() const;
+
+    // Producer side
+    void write(const float* samples, quint32 count);
+    void write(const qint16* samples, quint32 count);
+    void fill(float value, quint32 count);
+
+    // Consumer side
+    [[nodiscard]] Cursor cursor() const;
+    [[nodiscard]] quint32 available(const Cursor& cursor) const;
+    quint32 read(Cursor& cursor, float* out, quint32 count);
+    quint32 read(Cursor& cursor, double* out, quint32 count);
+
+private:
+    std::vector<float> m_data;
+    quint64 m_mask;
+
+    alignas(64) std::atomic<quint64> m_claim;
+    alignas(64) std::atomic<quint64> m_head;
+    std::atomic<quint64> m_dropped;
+    std::atomic<quint64> m_overruns;
+
+    template <typename F> void produce(quint32 count, F&& copy);
+    template <typename T> quint32 consume(Cursor& cursor, T* out, quint32 count);
+};
+
+} // namespace caelestia::services
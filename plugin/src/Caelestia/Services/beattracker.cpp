@@ -8,7 +8,7 @@ namespace caelestia::services {
 
 BeatProcessor::BeatProcessor(QObject* parent)
     : AudioProcessor(parent)
-    , m_tempo(new_aubio_tempo("default", 1024, ac::CHUNK_SIZE, ac::SAMPLE_RATE))
+    , m_tempo(new_aubio_tempo("default", 1024, ac::CHUNK_SIZE, sampleRate()))
     , m_in(new_fvec(ac::CHUNK_SIZE))
     , m_out(new_fvec(2)) {};
 
@@ -24,16 +24,27 @@ BeatProcessor::~BeatProcessor() {
     }
 }
 
+void BeatProcessor::reload() {
+    if (m_tempo) {
+        del_aubio_tempo(m_tempo);
+    }
+
+    m_tempo = new_aubio_tempo("default", 1024, ac::CHUNK_SIZE, sampleRate());
+}
+
 void BeatProcessor::process() {
     if (!m_tempo || !m_in) {
         return;
     }
 
-    AudioCollector::instance().readChunk(m_in->data);
+    // Aubio needs exactly one hop per call, so leave partial hops for the next tick
+    while (available() >= ac::CHUNK_SIZE) {
+        readChunk(m_in->data, ac::CHUNK_SIZE);
 
-    aubio_tempo_do(m_tempo, m_in, m_out);
-    if (!qFuzzyIsNull(m_out->data[0])) {
-        emit beat(aubio_tempo_get_bpm(m_tempo));
+        aubio_tempo_do(m_tempo, m_in, m_out);
+        if (!qFuzzyIsNull(m_out->data[0])) {
+            emit beat(aubio_tempo_get_bpm(m_tempo));
+        }
     }
 }
 
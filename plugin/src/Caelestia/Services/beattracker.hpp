@@ -18,6 +18,7 @@ signals:
 
 protected:
     void process() override;
+    void reload() override;
 
 private:
     aubio_tempo_t* m_tempo;
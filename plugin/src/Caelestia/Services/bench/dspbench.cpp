@@ -0,0 +1,100 @@
+#include "../dsp.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace caelestia::services;
+
+namespace {
+
+constexpr quint32 SAMPLES = 4096;
+constexpr int ITERATIONS = 20000;
+
+template <typename F> double samplesPerNs(F&& fn) {
+    // Warm up caches and let the CPU clock up before timing
+    for (int i = 0; i < ITERATIONS / 10; ++i) {
+        fn();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        fn();
+    }
+    const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    return static_cast<double>(SAMPLES) * ITERATIONS / elapsed;
+}
+
+template <typename T> bool matches(const std::vector<T>& a, const std::vector<T>& b) {
+    return std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+} // namespace
+
+int main() {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(-32768, 32767);
+
+    std::vector<qint16> s16(SAMPLES);
+    std::vector<float> f32(SAMPLES * 2);
+    for (auto& s : s16) {
+        s = static_cast<qint16>(dist(rng));
+    }
+    for (auto& f : f32) {
+        f = static_cast<float>(dist(rng)) / 32768.0f;
+    }
+
+    const auto* reference = dsp::kernels(dsp::Isa::Scalar);
+    std::vector<float> refF32(SAMPLES);
+    std::vector<double> refF64(SAMPLES);
+    std::vector<float> refMono(SAMPLES);
+    reference->s16ToF32(s16.data(), refF32.data(), SAMPLES);
+    reference->f32ToF64(f32.data(), refF64.data(), SAMPLES);
+    reference->stereoToMono(f32.data(), refMono.data(), SAMPLES);
+
+    std::printf("dispatch: %s\n", dsp::isaName(dsp::isa()));
+    std::printf("%-8s %-14s %12s\n", "isa", "kernel", "samples/ns");
+
+    bool ok = true;
+    for (const auto isa : { dsp::Isa::Scalar, dsp::Isa::Sse2, dsp::Isa::Avx2 }) {
+        const auto* k = dsp::kernels(isa);
+        if (!k) {
+            std::printf("%-8s unsupported\n", dsp::isaName(isa));
+            continue;
+        }
+
+        std::vector<float> outF32(SAMPLES);
+        std::vector<double> outF64(SAMPLES);
+        std::vector<float> outMono(SAMPLES);
+        std::vector<float> gainBuf(f32.begin(), f32.begin() + SAMPLES);
+
+        const double s16Rate = samplesPerNs([&] {
+            k->s16ToF32(s16.data(), outF32.data(), SAMPLES);
+        });
+        const double f64Rate = samplesPerNs([&] {
+            k->f32ToF64(f32.data(), outF64.data(), SAMPLES);
+        });
+        const double monoRate = samplesPerNs([&] {
+            k->stereoToMono(f32.data(), outMono.data(), SAMPLES);
+        });
+        const double gainRate = samplesPerNs([&] {
+            k->gain(gainBuf.data(), SAMPLES, 1.0f);
+        });
+
+        const bool s16Ok = matches(outF32, refF32);
+        const bool f64Ok = matches(outF64, refF64);
+        const bool monoOk = matches(outMono, refMono);
+        ok = ok && s16Ok && f64Ok && monoOk;
+
+        const char* name = dsp::isaName(isa);
+        std::printf("%-8s %-14s %12.3f %s\n", name, "s16ToF32", s16Rate, s16Ok ? "" : "MISMATCH");
+        std::printf("%-8s %-14s %12.3f %s\n", name, "f32ToF64", f64Rate, f64Ok ? "" : "MISMATCH");
+        std::printf("%-8s %-14s %12.3f %s\n", name, "stereoToMono", monoRate, monoOk ? "" : "MISMATCH");
+        std::printf("%-8s %-14s %12.3f\n", name, "gain", gainRate);
+    }
+
+    return ok ? 0 : 1;
+}
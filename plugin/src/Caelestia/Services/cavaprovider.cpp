@@ -2,7 +2,9 @@
 
 #include "audiocollector.hpp"
 #include "audioprovider.hpp"
+#include <algorithm>
 #include <cava/cavacore.h>
+#include <cmath>
 #include <cstddef>
 #include <qloggingcategory.h>
 
@@ -11,12 +13,57 @@ Q_LOGGING_CATEGORY(lcCavaProcessor, "caelestia.services.cava.processor", QtInfoM
 
 namespace caelestia::services {
 
+namespace {
+
+constexpr int FRESH = 4;
+constexpr double CHANGE_EPSILON = 1e-4;
+
+void monstercat(const double* in, double* left, double* out, int bars) {
+    const double inv = 1.0 / 1.5;
+
+    // The carries are serial, so run both passes into separate buffers and combine afterwards
+    double carry = 0.0;
+    for (int i = 0; i < bars; ++i) {
+        carry = std::max(in[i], carry * inv);
+        left[i] = carry;
+    }
+
+    carry = 0.0;
+    for (int i = bars - 1; i >= 0; --i) {
+        carry = std::max(in[i], carry * inv);
+        out[i] = carry;
+    }
+
+    for (int i = 0; i < bars; ++i) {
+        out[i] = std::max(out[i], left[i]);
+    }
+}
+
+bool changed(const double* a, const double* b, int count) {
+    double diff = 0.0;
+    for (int i = 0; i < count; ++i) {
+        diff = std::max(diff, std::abs(a[i] - b[i]));
+    }
+    return diff > CHANGE_EPSILON;
+}
+
+} // namespace
+
 CavaProcessor::CavaProcessor(QObject* parent)
     : AudioProcessor(parent)
     , m_plan(nullptr)
     , m_in(new double[ac::CHUNK_SIZE])
     , m_out(nullptr)
-    , m_bars(0) {};
+    , m_bars(0)
+    , m_back(0)
+    , m_front(1)
+    , m_middle(2)
+    , m_notified(false)
+#ifdef QT_DEBUG
+    , m_allocations(0)
+#endif
+{
+}
 
 CavaProcessor::~CavaProcessor() {
     cleanup();
@@ -28,36 +75,85 @@ void CavaProcessor::process() {
         return;
     }
 
-    const int count = static_cast<int>(AudioCollector::instance().readChunk(m_in));
-
     // Process in data via cava
-    cava_execute(m_in, count, m_out, m_plan);
-
-    // Apply monstercat filter
-    QVector<double> values(m_bars);
+    bool processed = false;
+    while (const quint32 count = readChunk(m_in, ac::CHUNK_SIZE)) {
+        cava_execute(m_in, static_cast<int>(count), m_out, m_plan);
+        processed = true;
+    }
 
-    // Left to right pass
-    const double inv = 1.0 / 1.5;
-    double carry = 0.0;
-    for (int i = 0; i < m_bars; ++i) {
-        carry = std::max(m_out[i], carry * inv);
-        values[i] = carry;
+    if (!processed) {
+        return;
     }
 
-    // Right to left pass and combine
-    carry = 0.0;
-    for (int i = m_bars - 1; i >= 0; --i) {
-        carry = std::max(m_out[i], carry * inv);
-        values[i] = std::max(values[i], carry);
+    // Apply monstercat filter into the back buffer
+    auto& back = m_buffers[static_cast<size_t>(m_back)];
+    if (back.size() != static_cast<size_t>(m_bars)) {
+        back.resize(static_cast<size_t>(m_bars));
+        countAllocation();
     }
+    monstercat(m_out, m_left.data(), back.data(), m_bars);
 
     // Update values
-    if (values != m_values) {
-        m_values = std::move(values);
-        emit valuesChanged(m_values);
+    if (changed(back.data(), m_published.data(), m_bars)) {
+        std::copy(back.begin(), back.end(), m_published.begin());
+        publish();
+    }
+
+    reportAllocations();
+}
+
+void CavaProcessor::publish() {
+    m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+
+    // Only queue a notification if the consumer has handled the last one
+    if (!m_notified.exchange(true, std::memory_order_acq_rel)) {
+        emit valuesReady();
     }
 }
 
+bool CavaProcessor::takeValues(QVector<double>& out) {
+    m_notified.store(false, std::memory_order_release);
+
+    if (!(m_middle.load(std::memory_order_acquire) & FRESH)) {
+        return false;
+    }
+
+    m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & ~FRESH;
+    const auto& front = m_buffers[static_cast<size_t>(m_front)];
+
+    // Values from before a bar count change
+    if (front.size() != static_cast<size_t>(out.size())) {
+        return false;
+    }
+
+    // Only happens if a consumer kept a copy of the values from two updates ago
+    if (!out.isDetached()) {
+        countAllocation();
+    }
+    std::copy(front.begin(), front.end(), out.begin());
+
+    return true;
+}
+
+void CavaProcessor::countAllocation() {
+#ifdef QT_DEBUG
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+void CavaProcessor::reportAllocations() {
+#ifdef QT_DEBUG
+    if (!m_allocationTimer.isValid()) {
+        m_allocationTimer.start();
+    } else if (m_allocationTimer.elapsed() >= 1000) {
+        const int allocations = m_allocations.exchange(0, std::memory_order_relaxed);
+        qCDebug(lcCavaProcessor) << "process:" << allocations << "allocations/s";
+        m_allocationTimer.restart();
+    }
+#endif
+}
+
 void CavaProcessor::setBars(int bars) {
     if (bars < 0) {
         qCWarning(lcCavaProcessor) << "setBars: bars must be greater than 0. Setting to 0.";
@@ -92,18 +188,21 @@ void CavaProcessor::initCava() {
         return;
     }
 
-    m_plan = cava_init(m_bars, ac::SAMPLE_RATE, 1, 1, 0.85, 50, 10000);
+    m_plan = cava_init(m_bars, sampleRate(), 1, 1, 0.85, 50, 10000);
     m_out = new double[static_cast<size_t>(m_bars)];
+    m_left.assign(static_cast<size_t>(m_bars), 0.0);
+    m_published.assign(static_cast<size_t>(m_bars), 0.0);
 }
 
 CavaProvider::CavaProvider(QObject* parent)
     : AudioProvider(parent)
     , m_bars(0)
-    , m_values(m_bars, 0.0) {
+    , m_current(0) {
     m_processor = new CavaProcessor();
     init();
 
-    connect(static_cast<CavaProcessor*>(m_processor), &CavaProcessor::valuesChanged, this, &CavaProvider::updateValues);
+    connect(static_cast<CavaProcessor*>(m_processor), &CavaProcessor::valuesReady, this, &CavaProvider::updateValues,
+        Qt::QueuedConnection);
 }
 
 int CavaProvider::bars() const {
@@ -120,7 +219,9 @@ void CavaProvider::setBars(int bars) {
         return;
     }
 
-    m_values.resize(bars, 0.0);
+    for (auto& values : m_values) {
+        values.resize(bars, 0.0);
+    }
     m_bars = bars;
     emit barsChanged();
     emit valuesChanged();
@@ -130,12 +231,12 @@ void CavaProvider::setBars(int bars) {
 }
 
 QVector<double> CavaProvider::values() const {
-    return m_values;
+    return m_values[m_current];
 }
 
-void CavaProvider::updateValues(QVector<double> values) {
-    if (values != m_values) {
-        m_values = values;
+void CavaProvider::updateValues() {
+    if (static_cast<CavaProcessor*>(m_processor)->takeValues(m_values[m_current ^ 1])) {
+        m_current ^= 1;
         emit valuesChanged();
     }
 }
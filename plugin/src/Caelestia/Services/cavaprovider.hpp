@@ -1,8 +1,12 @@
 #pragma once
 
 #include "audioprovider.hpp"
+#include <array>
+#include <atomic>
 #include <cava/cavacore.h>
+#include <qelapsedtimer.h>
 #include <qqmlintegration.h>
+#include <vector>
 
 namespace caelestia::services {
 
@@ -15,11 +19,15 @@ public:
 
     void setBars(int bars);
 
+    // Called from the consumer thread, returns whether out was updated
+    bool takeValues(QVector<double>& out);
+
 signals:
-    void valuesChanged(QVector<double> values);
+    void valuesReady();
 
 protected:
     void process() override;
+    void reload() override;
 
 private:
     struct cava_plan* m_plan;
@@ -27,11 +35,28 @@ private:
     double* m_out;
 
     int m_bars;
-    QVector<double> m_values;
 
-    void reload();
+    // Triple buffer, the producer owns m_back, the consumer owns m_front and they swap through m_middle
+    std::array<std::vector<double>, 3> m_buffers;
+    int m_back;
+    int m_front;
+    std::atomic<int> m_middle;
+    std::atomic<bool> m_notified;
+
+    std::vector<double> m_left;
+    std::vector<double> m_published;
+
+#ifdef QT_DEBUG
+    std::atomic<int> m_allocations;
+    QElapsedTimer m_allocationTimer;
+#endif
+
     void initCava();
     void cleanup();
+    void publish();
+
+    void countAllocation();
+    void reportAllocations();
 };
 
 class CavaProvider : public AudioProvider {
@@ -56,9 +81,13 @@ signals:
 
 private:
     int m_bars;
-    QVector<double> m_values;
 
-    void updateValues(QVector<double> values);
+    // Published values and a spare to write the next ones into, swapped each update so consumers still holding the
+    // last values never make a write detach
+    std::array<QVector<double>, 2> m_values;
+    size_t m_current;
+
+    void updateValues();
 };
 
 } // namespace caelestia::services
@@ -0,0 +1,228 @@
+#include "dsp.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CAELESTIA_DSP_X86
+#include <immintrin.h>
+#endif
+
+namespace caelestia::services::dsp {
+
+namespace {
+
+constexpr float S16_SCALE = 1.0f / 32768.0f;
+
+namespace scalar {
+
+void s16ToF32(const qint16* in, float* out, quint32 count) {
+    for (quint32 i = 0; i < count; ++i) {
+        out[i] = static_cast<float>(in[i]) * S16_SCALE;
+    }
+}
+
+void f32ToF64(const float* in, double* out, quint32 count) {
+    for (quint32 i = 0; i < count; ++i) {
+        out[i] = static_cast<double>(in[i]);
+    }
+}
+
+void stereoToMono(const float* in, float* out, quint32 frames) {
+    for (quint32 i = 0; i < frames; ++i) {
+        out[i] = (in[2 * i] + in[2 * i + 1]) * 0.5f;
+    }
+}
+
+void gain(float* data, quint32 count, float factor) {
+    for (quint32 i = 0; i < count; ++i) {
+        data[i] *= factor;
+    }
+}
+
+constexpr Kernels KERNELS = { s16ToF32, f32ToF64, stereoToMono, gain };
+
+} // namespace scalar
+
+#ifdef CAELESTIA_DSP_X86
+
+namespace sse2 {
+
+__attribute__((target("sse2"))) void s16ToF32(const qint16* in, float* out, quint32 count) {
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+    quint32 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        // Interleave with itself then arithmetic shift to sign extend
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    scalar::s16ToF32(in + i, out + i, count - i);
+}
+
+__attribute__((target("sse2"))) void f32ToF64(const float* in, double* out, quint32 count) {
+    quint32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 f = _mm_loadu_ps(in + i);
+        _mm_storeu_pd(out + i, _mm_cvtps_pd(f));
+        _mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+    }
+    scalar::f32ToF64(in + i, out + i, count - i);
+}
+
+__attribute__((target("sse2"))) void stereoToMono(const float* in, float* out, quint32 frames) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    quint32 i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        const __m128 a = _mm_loadu_ps(in + 2 * i);
+        const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+        const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+    }
+    scalar::stereoToMono(in + 2 * i, out + i, frames - i);
+}
+
+__attribute__((target("sse2"))) void gain(float* data, quint32 count, float factor) {
+    const __m128 g = _mm_set1_ps(factor);
+    quint32 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+    }
+    scalar::gain(data + i, count - i, factor);
+}
+
+constexpr Kernels KERNELS = { s16ToF32, f32ToF64, stereoToMono, gain };
+
+} // namespace sse2
+
+namespace avx2 {
+
+__attribute__((target("avx2"))) void s16ToF32(const qint16* in, float* out, quint32 count) {
+    const __m256 scale = _mm256_set1_ps(S16_SCALE);
+    quint32 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        const __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(s));
+        const __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(s, 1));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+        _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+    }
+    sse2::s16ToF32(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2"))) void f32ToF64(const float* in, double* out, quint32 count) {
+    quint32 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 f = _mm256_loadu_ps(in + i);
+        _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm256_castps256_ps128(f)));
+        _mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)));
+    }
+    sse2::f32ToF64(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2"))) void stereoToMono(const float* in, float* out, quint32 frames) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    quint32 i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        const __m256 a = _mm256_loadu_ps(in + 2 * i);
+        const __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+        // Shuffles work per 128 bit lane, so the sums come out as 0 1 4 5 2 3 6 7 and need reordering
+        const __m256 left = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m256 right = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m256 sum = _mm256_mul_ps(_mm256_add_ps(left, right), half);
+        const __m256d ordered = _mm256_permute4x64_pd(_mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_ps(out + i, _mm256_castpd_ps(ordered));
+    }
+    sse2::stereoToMono(in + 2 * i, out + i, frames - i);
+}
+
+__attribute__((target("avx2"))) void gain(float* data, quint32 count, float factor) {
+    const __m256 g = _mm256_set1_ps(factor);
+    quint32 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), g));
+    }
+    sse2::gain(data + i, count - i, factor);
+}
+
+constexpr Kernels KERNELS = { s16ToF32, f32ToF64, stereoToMono, gain };
+
+} // namespace avx2
+
+#endif
+
+Isa detectIsa() {
+#ifdef CAELESTIA_DSP_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Isa::Avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return Isa::Sse2;
+    }
+#endif
+    return Isa::Scalar;
+}
+
+const Kernels& active() {
+    static const Kernels* selected = kernels(isa());
+    return *selected;
+}
+
+} // namespace
+
+Isa isa() {
+    static const Isa detected = detectIsa();
+    return detected;
+}
+
+const char* isaName(Isa isa) {
+    switch (isa) {
+    case Isa::Scalar:
+        return "scalar";
+    case Isa::Sse2:
+        return "sse2";
+    case Isa::Avx2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+const Kernels* kernels(Isa isa) {
+    if (isa > dsp::isa()) {
+        return nullptr;
+    }
+
+    switch (isa) {
+    case Isa::Scalar:
+        return &scalar::KERNELS;
+#ifdef CAELESTIA_DSP_X86
+    case Isa::Sse2:
+        return &sse2::KERNELS;
+    case Isa::Avx2:
+        return &avx2::KERNELS;
+#else
+    default:
+        break;
+#endif
+    }
+    return nullptr;
+}
+
+void s16ToF32(const qint16* in, float* out, quint32 count) {
+    active().s16ToF32(in, out, count);
+}
+
+void f32ToF64(const float* in, double* out, quint32 count) {
+    active().f32ToF64(in, out, count);
+}
+
+void stereoToMono(const float* in, float* out, quint32 frames) {
+    active().stereoToMono(in, out, frames);
+}
+
+void gain(float* data, quint32 count, float factor) {
+    active().gain(data, count, factor);
+}
+
+} // namespace caelestia::services::dsp
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <qtypes.h>
+
+namespace caelestia::services::dsp {
+
+enum class Isa {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+struct Kernels {
+    void (*s16ToF32)(const qint16* in, float* out, quint32 count);
+    void (*f32ToF64)(const float* in, double* out, quint32 count);
+    void (*stereoToMono)(const float* in, float* out, quint32 frames);
+    void (*gain)(float* data, quint32 count, float factor);
+};
+
+// Best implementation supported by the running CPU, resolved once on first use
+[[nodiscard]] Isa isa();
+[[nodiscard]] const char* isaName(Isa isa);
+
+// Returns nullptr if the CPU does not support the given instruction set
+[[nodiscard]] const Kernels* kernels(Isa isa);
+
+void s16ToF32(const qint16* in, float* out, quint32 count);
+void f32ToF64(const float* in, double* out, quint32 count);
+void stereoToMono(const float* in, float* out, quint32 frames);
+void gain(float* data, quint32 count, float factor);
+
+} // namespace caelestia::services::dsp
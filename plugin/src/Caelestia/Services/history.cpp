@@ -0,0 +1,19 @@
+#include "history.hpp"
+
+#include <qloggingcategory.h>
+
+Q_LOGGING_CATEGORY(lcHistory, "caelestia.services.history", QtInfoMsg)
+
+namespace caelestia::services {
+
+void pushHistory(QObject* buffer, qreal value) {
+    if (!buffer) {
+        return;
+    }
+
+    if (!QMetaObject::invokeMethod(buffer, "push", Qt::DirectConnection, Q_ARG(qreal, value))) {
+        qCWarning(lcHistory) << "pushHistory: object" << buffer << "has no push(qreal) method";
+    }
+}
+
+} // namespace caelestia::services
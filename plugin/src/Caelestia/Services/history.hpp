@@ -0,0 +1,11 @@
+#pragma once
+
+#include <qobject.h>
+
+namespace caelestia::services {
+
+// History buffers are Caelestia.Internal CircularBuffers set from QML. This module doesn't link against Internal, so
+// the push goes through the meta object instead.
+void pushHistory(QObject* buffer, qreal value);
+
+} // namespace caelestia::services
@@ -0,0 +1,347 @@
+#include "networkmonitor.hpp"
+
+#include "history.hpp"
+#include "service.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <qloggingcategory.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+Q_LOGGING_CATEGORY(lcNmSampler, "caelestia.services.nm.sampler", QtInfoMsg)
+
+namespace caelestia::services {
+
+namespace {
+
+// Big enough for a full netlink dump part, the kernel caps those at a page or 32k
+constexpr size_t BUFFER_SIZE = 65536;
+
+constexpr size_t align(size_t len) {
+    return (len + NLMSG_ALIGNTO - 1) & ~static_cast<size_t>(NLMSG_ALIGNTO - 1);
+}
+
+constexpr size_t NL_HEADER = align(sizeof(nlmsghdr));
+constexpr size_t RTA_HEADER = align(sizeof(rtattr));
+
+// Only the byte counters are needed, which have been there since the struct was added
+constexpr size_t MIN_STATS_SIZE = offsetof(rtnl_link_stats64, tx_bytes) + sizeof(__u64);
+
+} // namespace
+
+NetworkSampler::NetworkSampler(QObject* parent)
+    : QObject(parent)
+    , m_buffer(BUFFER_SIZE) {}
+
+NetworkSampler::~NetworkSampler() {
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+void NetworkSampler::init() {
+    m_timer = new QTimer(this);
+    connect(m_timer, &QTimer::timeout, this, &NetworkSampler::sample);
+
+    m_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (m_fd < 0) {
+        qCWarning(lcNmSampler) << "init: failed to create netlink socket:" << strerror(errno);
+        return;
+    }
+
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    if (bind(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        qCWarning(lcNmSampler) << "init: failed to bind netlink socket:" << strerror(errno);
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void NetworkSampler::start(int interval) {
+    if (!m_timer) {
+        return;
+    }
+
+    // Counters keep accumulating into the totals across restarts, but the first rate after a gap would be meaningless
+    m_clock.invalidate();
+    m_timer->start(interval);
+    sample();
+}
+
+void NetworkSampler::stop() {
+    if (m_timer) {
+        m_timer->stop();
+    }
+}
+
+void NetworkSampler::setInterval(int interval) {
+    if (m_timer) {
+        m_timer->setInterval(interval);
+    }
+}
+
+void NetworkSampler::setSmoothingWindow(int window) {
+    m_smoothingWindow = window;
+}
+
+void NetworkSampler::sample() {
+    quint64 rx;
+    quint64 tx;
+    if (!readCounters(rx, tx)) {
+        return;
+    }
+
+    if (!m_initialised) {
+        m_prevRx = rx;
+        m_prevTx = tx;
+        m_initialised = true;
+        m_clock.start();
+        return;
+    }
+
+    // Interfaces going away make the sum drop, count that as no traffic rather than a wrap
+    const quint64 rxDelta = rx >= m_prevRx ? rx - m_prevRx : 0;
+    const quint64 txDelta = tx >= m_prevTx ? tx - m_prevTx : 0;
+    m_prevRx = rx;
+    m_prevTx = tx;
+
+    m_sample.downloadTotal += static_cast<qreal>(rxDelta);
+    m_sample.uploadTotal += static_cast<qreal>(txDelta);
+
+    if (!m_clock.isValid()) {
+        m_clock.start();
+        return;
+    }
+
+    const qint64 elapsed = m_clock.restart();
+    if (elapsed <= 0) {
+        return;
+    }
+
+    const qreal seconds = static_cast<qreal>(elapsed) / 1000.0;
+    const qreal download = static_cast<qreal>(rxDelta) / seconds;
+    const qreal upload = static_cast<qreal>(txDelta) / seconds;
+
+    // Time based so the smoothing stays the same whatever the interval is
+    const qreal alpha = m_smoothingWindow > 0
+                          ? 1.0 - std::exp(-static_cast<qreal>(elapsed) / static_cast<qreal>(m_smoothingWindow))
+                          : 1.0;
+    m_sample.downloadSpeed += (download - m_sample.downloadSpeed) * alpha;
+    m_sample.uploadSpeed += (upload - m_sample.uploadSpeed) * alpha;
+
+    emit sampled(m_sample);
+}
+
+bool NetworkSampler::readCounters(quint64& rx, quint64& tx) {
+    if (m_fd < 0) {
+        return false;
+    }
+
+    struct {
+        nlmsghdr header;
+        ifinfomsg info;
+    } request{};
+    request.header.nlmsg_len = static_cast<quint32>(NL_HEADER + sizeof(ifinfomsg));
+    request.header.nlmsg_type = RTM_GETLINK;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++m_seq;
+    request.info.ifi_family = AF_UNSPEC;
+
+    if (send(m_fd, &request, request.header.nlmsg_len, 0) < 0) {
+        qCWarning(lcNmSampler) << "readCounters: failed to send request:" << strerror(errno);
+        return false;
+    }
+
+    rx = 0;
+    tx = 0;
+    for (;;) {
+        const ssize_t received = recv(m_fd, m_buffer.data(), m_buffer.size(), 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qCWarning(lcNmSampler) << "readCounters: failed to receive:" << strerror(errno);
+            return false;
+        }
+
+        size_t remaining = static_cast<size_t>(received);
+        const char* pos = m_buffer.data();
+        while (remaining >= sizeof(nlmsghdr)) {
+            const auto* header = reinterpret_cast<const nlmsghdr*>(pos);
+            if (header->nlmsg_len < sizeof(nlmsghdr) || header->nlmsg_len > remaining) {
+                break;
+            }
+
+            if (header->nlmsg_seq == m_seq) {
+                if (header->nlmsg_type == NLMSG_DONE) {
+                    return true;
+                }
+                if (header->nlmsg_type == NLMSG_ERROR) {
+                    qCWarning(lcNmSampler) << "readCounters: link dump failed";
+                    return false;
+                }
+
+                if (header->nlmsg_type == RTM_NEWLINK && header->nlmsg_len >= NL_HEADER + sizeof(ifinfomsg)) {
+                    const auto* info = reinterpret_cast<const ifinfomsg*>(pos + NL_HEADER);
+
+                    // Loopback traffic never leaves the machine
+                    if (!(info->ifi_flags & IFF_LOOPBACK)) {
+                        const size_t attrsStart = NL_HEADER + align(sizeof(ifinfomsg));
+                        const char* attr = pos + attrsStart;
+                        size_t attrsLeft = header->nlmsg_len > attrsStart ? header->nlmsg_len - attrsStart : 0;
+
+                        while (attrsLeft >= sizeof(rtattr)) {
+                            const auto* rta = reinterpret_cast<const rtattr*>(attr);
+                            if (rta->rta_len < sizeof(rtattr) || rta->rta_len > attrsLeft) {
+                                break;
+                            }
+
+                            if (rta->rta_type == IFLA_STATS64 && rta->rta_len >= RTA_HEADER + MIN_STATS_SIZE) {
+                                // Attribute payloads are only 4 byte aligned, and the struct grows between kernels
+                                rtnl_link_stats64 stats{};
+                                std::memcpy(&stats, attr + RTA_HEADER,
+                                    std::min(sizeof(stats), static_cast<size_t>(rta->rta_len - RTA_HEADER)));
+                                rx += stats.rx_bytes;
+                                tx += stats.tx_bytes;
+                                break;
+                            }
+
+                            const size_t step = std::min(align(rta->rta_len), attrsLeft);
+                            attr += step;
+                            attrsLeft -= step;
+                        }
+                    }
+                }
+            }
+
+            const size_t step = std::min(align(header->nlmsg_len), remaining);
+            pos += step;
+            remaining -= step;
+        }
+    }
+}
+
+NetworkMonitor::NetworkMonitor(QObject* parent)
+    : Service(parent)
+    , m_thread(new QThread(this))
+    , m_sampler(new NetworkSampler)
+    , m_running(false)
+    , m_interval(1000)
+    , m_smoothingWindow(nm::DEFAULT_SMOOTHING_WINDOW) {
+    m_sampler->moveToThread(m_thread);
+
+    connect(m_thread, &QThread::started, m_sampler, &NetworkSampler::init);
+    connect(m_thread, &QThread::finished, m_sampler, &NetworkSampler::deleteLater);
+    connect(m_sampler, &NetworkSampler::sampled, this, &NetworkMonitor::updateSample);
+
+    m_thread->start();
+}
+
+NetworkMonitor::~NetworkMonitor() {
+    m_thread->quit();
+    m_thread->wait();
+}
+
+int NetworkMonitor::interval() const {
+    return m_interval;
+}
+
+void NetworkMonitor::setInterval(int interval) {
+    if (m_interval == interval) {
+        return;
+    }
+
+    m_interval = interval;
+    emit intervalChanged();
+
+    QMetaObject::invokeMethod(m_sampler, &NetworkSampler::setInterval, interval);
+}
+
+int NetworkMonitor::smoothingWindow() const {
+    return m_smoothingWindow;
+}
+
+void NetworkMonitor::setSmoothingWindow(int window) {
+    if (m_smoothingWindow == window) {
+        return;
+    }
+
+    m_smoothingWindow = window;
+    emit smoothingWindowChanged();
+
+    QMetaObject::invokeMethod(m_sampler, &NetworkSampler::setSmoothingWindow, window);
+}
+
+QObject* NetworkMonitor::downloadHistory() const {
+    return m_downloadHistory;
+}
+
+void NetworkMonitor::setDownloadHistory(QObject* buffer) {
+    if (m_downloadHistory == buffer) {
+        return;
+    }
+
+    m_downloadHistory = buffer;
+    emit downloadHistoryChanged();
+}
+
+QObject* NetworkMonitor::uploadHistory() const {
+    return m_uploadHistory;
+}
+
+void NetworkMonitor::setUploadHistory(QObject* buffer) {
+    if (m_uploadHistory == buffer) {
+        return;
+    }
+
+    m_uploadHistory = buffer;
+    emit uploadHistoryChanged();
+}
+
+qreal NetworkMonitor::downloadSpeed() const {
+    return m_sample.downloadSpeed;
+}
+
+qreal NetworkMonitor::uploadSpeed() const {
+    return m_sample.uploadSpeed;
+}
+
+qreal NetworkMonitor::downloadTotal() const {
+    return m_sample.downloadTotal;
+}
+
+qreal NetworkMonitor::uploadTotal() const {
+    return m_sample.uploadTotal;
+}
+
+void NetworkMonitor::start() {
+    m_running = true;
+    QMetaObject::invokeMethod(m_sampler, &NetworkSampler::start, m_interval);
+}
+
+void NetworkMonitor::stop() {
+    m_running = false;
+    QMetaObject::invokeMethod(m_sampler, &NetworkSampler::stop);
+}
+
+void NetworkMonitor::updateSample(const NetworkSample& sample) {
+    if (!m_running) {
+        return;
+    }
+
+    m_sample = sample;
+    emit updated();
+
+    pushHistory(m_downloadHistory, sample.downloadSpeed);
+    pushHistory(m_uploadHistory, sample.uploadSpeed);
+}
+
+} // namespace caelestia::services
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "service.hpp"
+#include <qelapsedtimer.h>
+#include <qpointer.h>
+#include <qqmlintegration.h>
+#include <qthread.h>
+#include <qtimer.h>
+#include <vector>
+
+namespace caelestia::services {
+
+namespace nm {
+
+constexpr int DEFAULT_SMOOTHING_WINDOW = 2000; // ms, roughly how long a change in rate takes to mostly show
+
+} // namespace nm
+
+struct NetworkSample {
+    qreal downloadSpeed = 0; // Bytes per second
+    qreal uploadSpeed = 0;
+    qreal downloadTotal = 0; // Bytes since sampling started
+    qreal uploadTotal = 0;
+};
+
+class NetworkSampler : public QObject {
+    Q_OBJECT
+
+public:
+    explicit NetworkSampler(QObject* parent = nullptr);
+    ~NetworkSampler();
+
+public slots:
+    void init();
+    void start(int interval);
+    void stop();
+    void setInterval(int interval);
+    void setSmoothingWindow(int window);
+
+signals:
+    void sampled(const caelestia::services::NetworkSample& sample);
+
+private:
+    QTimer* m_timer = nullptr;
+    int m_fd = -1;
+    quint32 m_seq = 0;
+    std::vector<char> m_buffer;
+
+    QElapsedTimer m_clock;
+    bool m_initialised = false;
+    quint64 m_prevRx = 0;
+    quint64 m_prevTx = 0;
+    int m_smoothingWindow = nm::DEFAULT_SMOOTHING_WINDOW;
+    NetworkSample m_sample;
+
+    void sample();
+    [[nodiscard]] bool readCounters(quint64& rx, quint64& tx);
+};
+
+class NetworkMonitor : public Service {
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(int interval READ interval WRITE setInterval NOTIFY intervalChanged)
+    Q_PROPERTY(int smoothingWindow READ smoothingWindow WRITE setSmoothingWindow NOTIFY smoothingWindowChanged)
+
+    Q_PROPERTY(QObject* downloadHistory READ downloadHistory WRITE setDownloadHistory NOTIFY downloadHistoryChanged)
+    Q_PROPERTY(QObject* uploadHistory READ uploadHistory WRITE setUploadHistory NOTIFY uploadHistoryChanged)
+
+    Q_PROPERTY(qreal downloadSpeed READ downloadSpeed NOTIFY updated)
+    Q_PROPERTY(qreal uploadSpeed READ uploadSpeed NOTIFY updated)
+    Q_PROPERTY(qreal downloadTotal READ downloadTotal NOTIFY updated)
+    Q_PROPERTY(qreal uploadTotal READ uploadTotal NOTIFY updated)
+
+public:
+    explicit NetworkMonitor(QObject* parent = nullptr);
+    ~NetworkMonitor();
+
+    [[nodiscard]] int interval() const;
+    void setInterval(int interval);
+
+    // Time constant of the exponential smoothing applied to the rates in ms, 0 for raw rates
+    [[nodiscard]] int smoothingWindow() const;
+    void setSmoothingWindow(int window);
+
+    [[nodiscard]] QObject* downloadHistory() const;
+    void setDownloadHistory(QObject* buffer);
+
+    [[nodiscard]] QObject* uploadHistory() const;
+    void setUploadHistory(QObject* buffer);
+
+    [[nodiscard]] qreal downloadSpeed() const;
+    [[nodiscard]] qreal uploadSpeed() const;
+    [[nodiscard]] qreal downloadTotal() const;
+    [[nodiscard]] qreal uploadTotal() const;
+
+signals:
+    void intervalChanged();
+    void smoothingWindowChanged();
+    void downloadHistoryChanged();
+    void uploadHistoryChanged();
+    void updated();
+
+private:
+    QThread* m_thread;
+    NetworkSampler* m_sampler;
+    bool m_running;
+
+    int m_interval;
+    int m_smoothingWindow;
+
+    QPointer<QObject> m_downloadHistory;
+    QPointer<QObject> m_uploadHistory;
+
+    NetworkSample m_sample;
+
+    void start() override;
+    void stop() override;
+
+    void updateSample(const NetworkSample& sample);
+};
+
+} // namespace caelestia::services
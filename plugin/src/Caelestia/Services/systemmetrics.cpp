@@ -0,0 +1,677 @@
+#include "systemmetrics.hpp"
+
+#include "service.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <qdir.h>
+#include <qfile.h>
+#include <qfileinfo.h>
+#include <qhash.h>
+#include <qloggingcategory.h>
+#include <qmap.h>
+#include <qregularexpression.h>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <utility>
+
+Q_LOGGING_CATEGORY(lcSm, "caelestia.services.sm", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcSmSampler, "caelestia.services.sm.sampler", QtInfoMsg)
+
+namespace caelestia::services {
+
+namespace {
+
+constexpr size_t INITIAL_BUFFER_SIZE = 16384;
+
+int openFile(const QString& path) {
+    return open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+}
+
+void closeFile(int& fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+QByteArray readText(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    return file.readAll().trimmed();
+}
+
+// Minimal cursor over proc and sysfs text, which is all ASCII with space separated unsigned numbers
+struct Parser {
+    const char* p;
+    const char* end;
+
+    [[nodiscard]] bool atEnd() const { return p >= end; }
+
+    [[nodiscard]] bool startsWith(std::string_view s) const {
+        return static_cast<size_t>(end - p) >= s.size() && std::memcmp(p, s.data(), s.size()) == 0;
+    }
+
+    void skipSpaces() {
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            ++p;
+        }
+    }
+
+    void skipLine() {
+        while (p < end && *p != '\n') {
+            ++p;
+        }
+        if (p < end) {
+            ++p;
+        }
+    }
+
+    std::string_view field() {
+        skipSpaces();
+        const char* start = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\n') {
+            ++p;
+        }
+        return { start, static_cast<size_t>(p - start) };
+    }
+
+    quint64 number() {
+        skipSpaces();
+        quint64 value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + static_cast<quint64>(*p - '0');
+            ++p;
+        }
+        return value;
+    }
+};
+
+// Mount points in mountinfo escape spaces, tabs, newlines and backslashes as octal
+QByteArray unescapeMountPoint(std::string_view field) {
+    QByteArray out;
+    out.reserve(static_cast<qsizetype>(field.size()));
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] == '\\' && i + 3 < field.size() && field[i + 1] >= '0' && field[i + 1] <= '7') {
+            out += static_cast<char>((field[i + 1] - '0') * 64 + (field[i + 2] - '0') * 8 + (field[i + 3] - '0'));
+            i += 3;
+        } else {
+            out += field[i];
+        }
+    }
+    return out;
+}
+
+// Walks partitions and device mapper/md slaves up to the physical disk, same grouping lsblk gives
+QString diskFor(const QString& sysPath) {
+    if (sysPath.isEmpty()) {
+        return {};
+    }
+
+    if (QFileInfo::exists(sysPath + QStringLiteral("/partition"))) {
+        return diskFor(QFileInfo(sysPath).absolutePath());
+    }
+
+    const QDir slaves(sysPath + QStringLiteral("/slaves"));
+    const auto entries = slaves.entryList(QDir::AllEntries | QDir::NoDotAndDotDot, QDir::Name);
+    for (const auto& entry : entries) {
+        if (const auto disk = diskFor(QFileInfo(slaves.filePath(entry)).canonicalFilePath()); !disk.isEmpty()) {
+            return disk;
+        }
+    }
+    if (!entries.isEmpty()) {
+        return {};
+    }
+
+    const auto name = QFileInfo(sysPath).fileName();
+    for (const auto* prefix : { "loop", "ram", "zram", "sr" }) {
+        if (name.startsWith(QLatin1String(prefix))) {
+            return {};
+        }
+    }
+    return name;
+}
+
+// First temperature input whose label starts with one of the given labels, in order of preference
+int openTempInput(const QString& hwmon, const QStringList& labels) {
+    const QDir dir(hwmon);
+    const auto labelFiles = dir.entryList({ QStringLiteral("temp*_label") }, QDir::Files, QDir::Name);
+
+    for (const auto& wanted : labels) {
+        for (const auto& file : labelFiles) {
+            if (QString::fromUtf8(readText(dir.filePath(file))).startsWith(wanted)) {
+                auto input = file;
+                input.replace(QStringLiteral("_label"), QStringLiteral("_input"));
+                return openFile(dir.filePath(input));
+            }
+        }
+    }
+
+    return -1;
+}
+
+QString cleanCpuName(QString name) {
+    static const QRegularExpression junk(
+        QStringLiteral("\\(R\\)|\\(TM\\)|CPU|\\d+(?:th|nd|rd|st) Gen |Core |Processor"),
+        QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression spaces(QStringLiteral("\\s+"));
+    return name.remove(junk).replace(spaces, QStringLiteral(" ")).trimmed();
+}
+
+} // namespace
+
+SystemSampler::SystemSampler(QObject* parent)
+    : QObject(parent)
+    , m_buffer(INITIAL_BUFFER_SIZE) {}
+
+SystemSampler::~SystemSampler() {
+    closeFile(m_statFd);
+    closeFile(m_meminfoFd);
+    closeFile(m_mountinfoFd);
+    closeFile(m_cpuTempFd);
+    for (auto& fd : m_gpuBusyFds) {
+        closeFile(fd);
+    }
+    for (auto& fd : m_gpuTempFds) {
+        closeFile(fd);
+    }
+}
+
+void SystemSampler::init() {
+    m_timer = new QTimer(this);
+    connect(m_timer, &QTimer::timeout, this, &SystemSampler::sample);
+
+    m_statFd = openFile(QStringLiteral("/proc/stat"));
+    m_meminfoFd = openFile(QStringLiteral("/proc/meminfo"));
+    m_mountinfoFd = openFile(QStringLiteral("/proc/self/mountinfo"));
+    if (m_statFd < 0 || m_meminfoFd < 0 || m_mountinfoFd < 0) {
+        qCWarning(lcSmSampler) << "init: failed to open proc files:" << strerror(errno);
+    }
+
+    findSensors();
+
+    // Only read once, so not worth a hand written parser
+    QFile cpuinfo(QStringLiteral("/proc/cpuinfo"));
+    if (cpuinfo.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        static const QRegularExpression modelName(QStringLiteral("model name\\s*:\\s*(.+)"));
+        if (const auto match = modelName.match(QString::fromUtf8(cpuinfo.readAll())); match.hasMatch()) {
+            emit cpuNameChanged(cleanCpuName(match.captured(1)));
+        }
+    }
+}
+
+void SystemSampler::start(int interval) {
+    if (!m_timer) {
+        return;
+    }
+
+    m_timer->start(interval);
+    sample();
+}
+
+void SystemSampler::stop() {
+    if (m_timer) {
+        m_timer->stop();
+    }
+}
+
+void SystemSampler::setInterval(int interval) {
+    if (m_timer) {
+        m_timer->setInterval(interval);
+    }
+}
+
+void SystemSampler::setReadGpu(bool readGpu) {
+    m_readGpu = readGpu;
+}
+
+void SystemSampler::findSensors() {
+    // CPU package temperature, same preference order as the sensors output parsing this replaces
+    const QDir hwmons(QStringLiteral("/sys/class/hwmon"));
+    for (const auto& entry : hwmons.entryList(QDir::AllEntries | QDir::NoDotAndDotDot, QDir::Name)) {
+        const auto path = hwmons.filePath(entry);
+        const auto name = readText(path + QStringLiteral("/name"));
+
+        if (name == "coretemp") {
+            m_cpuTempFd = openTempInput(path, { QStringLiteral("Package id") });
+        } else if (name == "k10temp" || name == "zenpower") {
+            m_cpuTempFd = openTempInput(path, { QStringLiteral("Tdie"), QStringLiteral("Tctl") });
+        }
+
+        if (m_cpuTempFd >= 0) {
+            break;
+        }
+    }
+
+    // GPU busy and temperature from every DRM card, skipping connector entries like card0-DP-1
+    static const QRegularExpression cardName(QStringLiteral("^card\\d+$"));
+    const QDir drm(QStringLiteral("/sys/class/drm"));
+    for (const auto& entry : drm.entryList(QDir::AllEntries | QDir::NoDotAndDotDot, QDir::Name)) {
+        if (!cardName.match(entry).hasMatch()) {
+            continue;
+        }
+
+        const auto device = drm.filePath(entry) + QStringLiteral("/device");
+        if (const int fd = openFile(device + QStringLiteral("/gpu_busy_percent")); fd >= 0) {
+            m_gpuBusyFds.push_back(fd);
+        }
+
+        const QDir gpuHwmons(device + QStringLiteral("/hwmon"));
+        for (const auto& hwmon : gpuHwmons.entryList(QDir::AllEntries | QDir::NoDotAndDotDot, QDir::Name)) {
+            const auto path = gpuHwmons.filePath(hwmon);
+            int fd = openTempInput(path,
+                { QStringLiteral("edge"), QStringLiteral("GPU core"), QStringLiteral("junction"), QStringLiteral("mem") });
+            if (fd < 0 && !QFileInfo::exists(path + QStringLiteral("/temp1_label"))) {
+                fd = openFile(path + QStringLiteral("/temp1_input"));
+            }
+            if (fd >= 0) {
+                m_gpuTempFds.push_back(fd);
+            }
+        }
+    }
+
+    qCDebug(lcSmSampler) << "findSensors: cpu temp" << (m_cpuTempFd >= 0) << "gpu busy" << m_gpuBusyFds.size()
+                         << "gpu temp" << m_gpuTempFds.size();
+}
+
+void SystemSampler::sample() {
+    SystemSample sample;
+    sampleCpu(sample);
+    sampleMemory(sample);
+    sampleSensors(sample);
+    sampleDisks(sample);
+    emit sampled(sample);
+}
+
+void SystemSampler::sampleCpu(SystemSample& sample) {
+    const auto len = readFile(m_statFd);
+    if (len <= 0) {
+        return;
+    }
+
+    // The aggregate cpu line first, then one per core, each user nice system idle iowait irq softirq ...
+    Parser parser{ m_buffer.data(), m_buffer.data() + len };
+    size_t index = 0;
+    while (!parser.atEnd() && parser.startsWith("cpu")) {
+        parser.field();
+
+        quint64 fields[7];
+        quint64 total = 0;
+        for (auto& field : fields) {
+            field = parser.number();
+            total += field;
+        }
+        const quint64 idle = fields[3] + fields[4];
+
+        if (index >= m_cpuTimes.size()) {
+            m_cpuTimes.push_back({});
+        }
+        auto& prev = m_cpuTimes[index];
+
+        const quint64 totalDiff = total > prev.total ? total - prev.total : 0;
+        const quint64 idleDiff = idle > prev.idle ? idle - prev.idle : 0;
+        const qreal perc =
+            totalDiff > 0 ? 1.0 - static_cast<qreal>(std::min(idleDiff, totalDiff)) / static_cast<qreal>(totalDiff) : 0;
+        prev = { total, idle };
+
+        if (index == 0) {
+            sample.cpuPerc = perc;
+        } else {
+            sample.corePercs << perc;
+        }
+
+        parser.skipLine();
+        ++index;
+    }
+}
+
+void SystemSampler::sampleMemory(SystemSample& sample) {
+    const auto len = readFile(m_meminfoFd);
+    if (len <= 0) {
+        return;
+    }
+
+    Parser parser{ m_buffer.data(), m_buffer.data() + len };
+    quint64 total = 0;
+    quint64 available = 0;
+    bool hasTotal = false;
+    bool hasAvailable = false;
+    while (!parser.atEnd() && !(hasTotal && hasAvailable)) {
+        if (parser.startsWith("MemTotal:")) {
+            parser.field();
+            total = parser.number();
+            hasTotal = true;
+        } else if (parser.startsWith("MemAvailable:")) {
+            parser.field();
+            available = parser.number();
+            hasAvailable = true;
+        }
+        parser.skipLine();
+    }
+
+    sample.memTotal = static_cast<qreal>(std::max<quint64>(total, 1));
+    sample.memUsed = static_cast<qreal>(total > available ? total - available : 0);
+}
+
+void SystemSampler::sampleSensors(SystemSample& sample) {
+    qint64 value;
+    if (readNumber(m_cpuTempFd, value)) {
+        sample.cpuTemp = static_cast<qreal>(value) / 1000.0;
+    }
+
+    if (!m_readGpu) {
+        return;
+    }
+
+    qint64 sum = 0;
+    qint64 count = 0;
+    for (const int fd : m_gpuBusyFds) {
+        if (readNumber(fd, value)) {
+            sum += value;
+            count++;
+        }
+    }
+    sample.gpuPerc = count > 0 ? static_cast<qreal>(sum) / static_cast<qreal>(count) / 100.0 : 0;
+
+    sum = 0;
+    count = 0;
+    for (const int fd : m_gpuTempFds) {
+        if (readNumber(fd, value)) {
+            sum += value;
+            count++;
+        }
+    }
+    sample.gpuTemp = count > 0 ? static_cast<qreal>(sum) / static_cast<qreal>(count) / 1000.0 : 0;
+}
+
+void SystemSampler::sampleDisks(SystemSample& sample) {
+    const auto len = readFile(m_mountinfoFd);
+    if (len > 0) {
+        // Device resolution walks sysfs, so only redo it when something was mounted or unmounted
+        const QByteArray mountinfo(m_buffer.data(), len);
+        if (mountinfo != m_mountinfo) {
+            m_mountinfo = mountinfo;
+            resolveDevices();
+        }
+    }
+
+    struct Usage {
+        quint64 used = 0;
+        quint64 size = 0;
+        bool root = false;
+    };
+
+    // Sorted by disk name
+    QMap<QString, Usage> disks;
+    for (const auto& device : std::as_const(m_devices)) {
+        struct statvfs st;
+        if (statvfs(device.mountPoint.constData(), &st) != 0) {
+            continue;
+        }
+
+        auto& usage = disks[device.disk];
+        usage.size += static_cast<quint64>(st.f_blocks) * st.f_frsize;
+        usage.used += static_cast<quint64>(st.f_blocks - st.f_bfree) * st.f_frsize;
+        usage.root = usage.root || device.root;
+    }
+
+    quint64 totalUsed = 0;
+    quint64 totalSize = 0;
+    QVariantList rootDisks;
+    QVariantList otherDisks;
+    for (auto it = disks.cbegin(); it != disks.cend(); ++it) {
+        const auto& usage = it.value();
+        if (usage.size == 0) {
+            continue;
+        }
+
+        totalUsed += usage.used;
+        totalSize += usage.size;
+
+        const qreal used = static_cast<qreal>(usage.used) / 1024.0;
+        const qreal total = static_cast<qreal>(usage.size) / 1024.0;
+        const QVariantMap disk{
+            { QStringLiteral("mount"), it.key() },
+            { QStringLiteral("used"), used },
+            { QStringLiteral("total"), total },
+            { QStringLiteral("free"), total - used },
+            { QStringLiteral("perc"), used / total },
+            { QStringLiteral("hasRoot"), usage.root },
+        };
+        (usage.root ? rootDisks : otherDisks) << disk;
+    }
+
+    // The disk with root first, then the rest alphabetically
+    sample.disks = rootDisks + otherDisks;
+    sample.storagePerc = totalSize > 0 ? static_cast<qreal>(totalUsed) / static_cast<qreal>(totalSize) : 0;
+}
+
+void SystemSampler::resolveDevices() {
+    m_devices.clear();
+
+    // Each block device is only counted once, under the first disk it resolves to
+    QHash<dev_t, qsizetype> seen;
+    Parser parser{ m_mountinfo.constData(), m_mountinfo.constData() + m_mountinfo.size() };
+    while (!parser.atEnd()) {
+        // id parent major:minor root mountpoint options [optional fields...] - fstype source superoptions
+        for (int i = 0; i < 4; ++i) {
+            parser.field();
+        }
+        const auto mountPoint = parser.field();
+        while (!parser.atEnd() && *parser.p != '\n' && parser.field() != "-") {
+        }
+        parser.field();
+        const auto source = parser.field();
+        parser.skipLine();
+
+        if (!source.starts_with("/dev/")) {
+            continue;
+        }
+
+        // Stat the source rather than trusting the mountinfo device number, btrfs reports an anonymous one
+        const std::string path(source);
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISBLK(st.st_mode)) {
+            continue;
+        }
+
+        const bool root = mountPoint == "/";
+        if (const auto it = seen.constFind(st.st_rdev); it != seen.cend()) {
+            if (it.value() >= 0 && root) {
+                m_devices[it.value()].root = true;
+            }
+            continue;
+        }
+
+        const auto sysPath =
+            QFileInfo(QStringLiteral("/sys/dev/block/%1:%2").arg(major(st.st_rdev)).arg(minor(st.st_rdev)))
+                .canonicalFilePath();
+        const auto disk = diskFor(sysPath);
+        if (disk.isEmpty()) {
+            seen.insert(st.st_rdev, -1);
+            continue;
+        }
+
+        seen.insert(st.st_rdev, m_devices.size());
+        m_devices << MountedDevice{ disk, unescapeMountPoint(mountPoint), root };
+    }
+
+    qCDebug(lcSmSampler) << "resolveDevices: found" << m_devices.size() << "mounted block devices";
+}
+
+qsizetype SystemSampler::readFile(int fd) {
+    if (fd < 0) {
+        return -1;
+    }
+
+    size_t len = 0;
+    for (;;) {
+        const ssize_t n = pread(fd, m_buffer.data() + len, m_buffer.size() - len, static_cast<off_t>(len));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        len += static_cast<size_t>(n);
+        if (len == m_buffer.size()) {
+            m_buffer.resize(m_buffer.size() * 2);
+        }
+    }
+
+    return static_cast<qsizetype>(len);
+}
+
+bool SystemSampler::readNumber(int fd, qint64& out) {
+    const auto len = readFile(fd);
+    if (len <= 0) {
+        return false;
+    }
+
+    Parser parser{ m_buffer.data(), m_buffer.data() + len };
+    const bool negative = parser.startsWith("-");
+    if (negative) {
+        parser.p++;
+    }
+    out = static_cast<qint64>(parser.number());
+    if (negative) {
+        out = -out;
+    }
+    return true;
+}
+
+SystemMetrics::SystemMetrics(QObject* parent)
+    : Service(parent)
+    , m_thread(new QThread(this))
+    , m_sampler(new SystemSampler)
+    , m_running(false)
+    , m_interval(1000)
+    , m_readGpu(false) {
+    m_sampler->moveToThread(m_thread);
+
+    connect(m_thread, &QThread::started, m_sampler, &SystemSampler::init);
+    connect(m_thread, &QThread::finished, m_sampler, &SystemSampler::deleteLater);
+    connect(m_sampler, &SystemSampler::cpuNameChanged, this, &SystemMetrics::setCpuName);
+    connect(m_sampler, &SystemSampler::sampled, this, &SystemMetrics::updateSample);
+
+    m_thread->start();
+}
+
+SystemMetrics::~SystemMetrics() {
+    m_thread->quit();
+    m_thread->wait();
+}
+
+int SystemMetrics::interval() const {
+    return m_interval;
+}
+
+void SystemMetrics::setInterval(int interval) {
+    if (m_interval == interval) {
+        return;
+    }
+
+    m_interval = interval;
+    emit intervalChanged();
+
+    QMetaObject::invokeMethod(m_sampler, &SystemSampler::setInterval, interval);
+}
+
+bool SystemMetrics::readGpu() const {
+    return m_readGpu;
+}
+
+void SystemMetrics::setReadGpu(bool readGpu) {
+    if (m_readGpu == readGpu) {
+        return;
+    }
+
+    m_readGpu = readGpu;
+    emit readGpuChanged();
+
+    QMetaObject::invokeMethod(m_sampler, &SystemSampler::setReadGpu, readGpu);
+}
+
+QString SystemMetrics::cpuName() const {
+    return m_cpuName;
+}
+
+qreal SystemMetrics::cpuPerc() const {
+    return m_sample.cpuPerc;
+}
+
+QList<qreal> SystemMetrics::corePercs() const {
+    return m_sample.corePercs;
+}
+
+qreal SystemMetrics::cpuTemp() const {
+    return m_sample.cpuTemp;
+}
+
+qreal SystemMetrics::gpuPerc() const {
+    return m_sample.gpuPerc;
+}
+
+qreal SystemMetrics::gpuTemp() const {
+    return m_sample.gpuTemp;
+}
+
+qreal SystemMetrics::memUsed() const {
+    return m_sample.memUsed;
+}
+
+qreal SystemMetrics::memTotal() const {
+    return m_sample.memTotal;
+}
+
+QVariantList SystemMetrics::disks() const {
+    return m_sample.disks;
+}
+
+qreal SystemMetrics::storagePerc() const {
+    return m_sample.storagePerc;
+}
+
+void SystemMetrics::start() {
+    m_running = true;
+    QMetaObject::invokeMethod(m_sampler, &SystemSampler::start, m_interval);
+}
+
+void SystemMetrics::stop() {
+    m_running = false;
+    QMetaObject::invokeMethod(m_sampler, &SystemSampler::stop);
+}
+
+void SystemMetrics::setCpuName(const QString& name) {
+    if (m_cpuName == name) {
+        return;
+    }
+
+    m_cpuName = name;
+    emit cpuNameChanged();
+}
+
+void SystemMetrics::updateSample(const SystemSample& sample) {
+    // A sample may still be in flight when the last ref goes away
+    if (!m_running) {
+        return;
+    }
+
+    m_sample = sample;
+    emit updated();
+
+    qCDebug(lcSm) << "updateSample: cpu" << sample.cpuPerc << "mem" << sample.memUsed << "disks" << sample.disks.size();
+}
+
+} // namespace caelestia::services
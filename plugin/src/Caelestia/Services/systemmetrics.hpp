@@ -0,0 +1,147 @@
+#pragma once
+
+#include "service.hpp"
+#include <qlist.h>
+#include <qqmlintegration.h>
+#include <qthread.h>
+#include <qtimer.h>
+#include <qvariant.h>
+#include <vector>
+
+namespace caelestia::services {
+
+struct SystemSample {
+    qreal cpuPerc = 0;
+    QList<qreal> corePercs;
+    qreal cpuTemp = 0;
+    qreal gpuPerc = 0;
+    qreal gpuTemp = 0;
+    qreal memUsed = 0;  // KiB
+    qreal memTotal = 0; // KiB
+    QVariantList disks;
+    qreal storagePerc = 0;
+};
+
+class SystemSampler : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SystemSampler(QObject* parent = nullptr);
+    ~SystemSampler();
+
+public slots:
+    void init();
+    void start(int interval);
+    void stop();
+    void setInterval(int interval);
+    void setReadGpu(bool readGpu);
+
+signals:
+    void cpuNameChanged(const QString& name);
+    void sampled(const caelestia::services::SystemSample& sample);
+
+private:
+    struct CpuTimes {
+        quint64 total = 0;
+        quint64 idle = 0;
+    };
+
+    struct MountedDevice {
+        QString disk;
+        QByteArray mountPoint;
+        bool root;
+    };
+
+    QTimer* m_timer = nullptr;
+    bool m_readGpu = false;
+
+    // Files are kept open for the lifetime of the sampler and re-read with pread
+    int m_statFd = -1;
+    int m_meminfoFd = -1;
+    int m_mountinfoFd = -1;
+    int m_cpuTempFd = -1;
+    std::vector<int> m_gpuBusyFds;
+    std::vector<int> m_gpuTempFds;
+
+    std::vector<char> m_buffer;
+    std::vector<CpuTimes> m_cpuTimes;
+    QByteArray m_mountinfo;
+    QList<MountedDevice> m_devices;
+
+    void findSensors();
+    void resolveDevices();
+
+    void sample();
+    void sampleCpu(SystemSample& sample);
+    void sampleMemory(SystemSample& sample);
+    void sampleSensors(SystemSample& sample);
+    void sampleDisks(SystemSample& sample);
+
+    [[nodiscard]] qsizetype readFile(int fd);
+    [[nodiscard]] bool readNumber(int fd, qint64& out);
+};
+
+class SystemMetrics : public Service {
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(int interval READ interval WRITE setInterval NOTIFY intervalChanged)
+    Q_PROPERTY(bool readGpu READ readGpu WRITE setReadGpu NOTIFY readGpuChanged)
+
+    Q_PROPERTY(QString cpuName READ cpuName NOTIFY cpuNameChanged)
+    Q_PROPERTY(qreal cpuPerc READ cpuPerc NOTIFY updated)
+    Q_PROPERTY(QList<qreal> corePercs READ corePercs NOTIFY updated)
+    Q_PROPERTY(qreal cpuTemp READ cpuTemp NOTIFY updated)
+    Q_PROPERTY(qreal gpuPerc READ gpuPerc NOTIFY updated)
+    Q_PROPERTY(qreal gpuTemp READ gpuTemp NOTIFY updated)
+    Q_PROPERTY(qreal memUsed READ memUsed NOTIFY updated)
+    Q_PROPERTY(qreal memTotal READ memTotal NOTIFY updated)
+    Q_PROPERTY(QVariantList disks READ disks NOTIFY updated)
+    Q_PROPERTY(qreal storagePerc READ storagePerc NOTIFY updated)
+
+public:
+    explicit SystemMetrics(QObject* parent = nullptr);
+    ~SystemMetrics();
+
+    [[nodiscard]] int interval() const;
+    void setInterval(int interval);
+
+    [[nodiscard]] bool readGpu() const;
+    void setReadGpu(bool readGpu);
+
+    [[nodiscard]] QString cpuName() const;
+    [[nodiscard]] qreal cpuPerc() const;
+    [[nodiscard]] QList<qreal> corePercs() const;
+    [[nodiscard]] qreal cpuTemp() const;
+    [[nodiscard]] qreal gpuPerc() const;
+    [[nodiscard]] qreal gpuTemp() const;
+    [[nodiscard]] qreal memUsed() const;
+    [[nodiscard]] qreal memTotal() const;
+    [[nodiscard]] QVariantList disks() const;
+    [[nodiscard]] qreal storagePerc() const;
+
+signals:
+    void intervalChanged();
+    void readGpuChanged();
+    void cpuNameChanged();
+    void updated();
+
+private:
+    QThread* m_thread;
+    SystemSampler* m_sampler;
+    bool m_running;
+
+    int m_interval;
+    bool m_readGpu;
+
+    QString m_cpuName;
+    SystemSample m_sample;
+
+    void start() override;
+    void stop() override;
+
+    void setCpuName(const QString& name);
+    void updateSample(const SystemSample& sample);
+};
+
+} // namespace caelestia::services
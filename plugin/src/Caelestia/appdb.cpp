@@ -1,5 +1,7 @@
 #include "appdb.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <qloggingcategory.h>
 #include <qsqldatabase.h>
 #include <qsqlquery.h>
@@ -9,10 +11,41 @@ Q_LOGGING_CATEGORY(lcAppDb, "caelestia.appdb", QtInfoMsg)
 
 namespace caelestia {
 
-AppEntry::AppEntry(QObject* entry, unsigned int frequency, QObject* parent)
+namespace {
+
+// A launch counts for half as much after this many seconds
+constexpr qreal FRECENCY_HALF_LIFE = 7 * 24 * 60 * 60;
+
+qreal halfLives(qint64 time) {
+    return static_cast<qreal>(time) / FRECENCY_HALF_LIFE;
+}
+
+AppUsage recordLaunch(AppUsage usage, qint64 now) {
+    // Decay the old score to now and add one for this launch, in log space
+    const qreal t = halfLives(now);
+    usage.frecency = qIsInf(usage.frecency) ? t : std::log2(std::exp2(usage.frecency - t) + 1.0) + t;
+    usage.frequency++;
+    usage.lastUsed = now;
+    return usage;
+}
+
+// Lots of apps share the same categories, so share the strings too
+QString intern(const QString& str) {
+    static QSet<QString> s_pool;
+    const auto it = s_pool.constFind(str);
+    if (it != s_pool.constEnd()) {
+        return *it;
+    }
+    s_pool.insert(str);
+    return str;
+}
+
+} // namespace
+
+AppEntry::AppEntry(QObject* entry, const AppUsage& usage, QObject* parent)
     : QObject(parent)
     , m_entry(entry)
-    , m_frequency(frequency) {
+    , m_usage(usage) {
     const auto mo = m_entry->metaObject();
     const auto tmo = &AppEntry::staticMetaObject;
 
@@ -23,6 +56,38 @@ AppEntry::AppEntry(QObject* entry, unsigned int frequency, QObject* parent)
         QObject::connect(m_entry, metaProp.notifySignal(), this, thisMetaProp.notifySignal());
     }
 
+    m_data.id = readString("id");
+    m_data.name = readString("name");
+    m_data.comment = readString("comment");
+    m_data.execString = readString("execString");
+    m_data.startupClass = readString("startupClass");
+    m_data.genericName = readString("genericName");
+    m_data.categories = intern(readList("categories"));
+    m_data.keywords = readList("keywords");
+
+    // Connected before anyone else can be, so the snapshot is already fresh when they get the signal
+    QObject::connect(this, &AppEntry::nameChanged, this, [this]() {
+        m_data.name = readString("name");
+    });
+    QObject::connect(this, &AppEntry::commentChanged, this, [this]() {
+        m_data.comment = readString("comment");
+    });
+    QObject::connect(this, &AppEntry::execStringChanged, this, [this]() {
+        m_data.execString = readString("execString");
+    });
+    QObject::connect(this, &AppEntry::startupClassChanged, this, [this]() {
+        m_data.startupClass = readString("startupClass");
+    });
+    QObject::connect(this, &AppEntry::genericNameChanged, this, [this]() {
+        m_data.genericName = readString("genericName");
+    });
+    QObject::connect(this, &AppEntry::categoriesChanged, this, [this]() {
+        m_data.categories = intern(readList("categories"));
+    });
+    QObject::connect(this, &AppEntry::keywordsChanged, this, [this]() {
+        m_data.keywords = readList("keywords");
+    });
+
     QObject::connect(m_entry, &QObject::destroyed, this, [this]() {
         m_entry = nullptr;
         deleteLater();
@@ -33,92 +98,145 @@ QObject* AppEntry::entry() const {
     return m_entry;
 }
 
-quint32 AppEntry::frequency() const {
-    return m_frequency;
+const AppUsage& AppEntry::usage() const {
+    return m_usage;
 }
 
-void AppEntry::setFrequency(unsigned int frequency) {
-    if (m_frequency != frequency) {
-        m_frequency = frequency;
+void AppEntry::setUsage(const AppUsage& usage) {
+    const AppUsage old = m_usage;
+    m_usage = usage;
+
+    if (old.frequency != usage.frequency) {
         emit frequencyChanged();
     }
+    if (old.lastUsed != usage.lastUsed) {
+        emit lastUsedChanged();
+    }
+    const bool frecencyChanged = qIsInf(old.frecency) || qIsInf(usage.frecency)
+                                   ? qIsInf(old.frecency) != qIsInf(usage.frecency)
+                                   : !qFuzzyCompare(old.frecency, usage.frecency);
+    if (frecencyChanged) {
+        emit frecencyChanged();
+    }
 }
 
-void AppEntry::incrementFrequency() {
-    m_frequency++;
-    emit frequencyChanged();
+quint32 AppEntry::frequency() const {
+    return m_usage.frequency;
 }
 
-QString AppEntry::id() const {
-    if (!m_entry) {
-        return "";
+QDateTime AppEntry::lastUsed() const {
+    if (m_usage.lastUsed == 0) {
+        return QDateTime();
     }
-    return m_entry->property("id").toString();
+    return QDateTime::fromSecsSinceEpoch(m_usage.lastUsed);
 }
 
-QString AppEntry::name() const {
-    if (!m_entry) {
-        return "";
+qreal AppEntry::frecency() const {
+    if (qIsInf(m_usage.frecency)) {
+        return 0;
     }
-    return m_entry->property("name").toString();
+    return std::exp2(m_usage.frecency - halfLives(QDateTime::currentSecsSinceEpoch()));
+}
+
+QString AppEntry::id() const {
+    return m_data.id;
+}
+
+QString AppEntry::name() const {
+    return m_data.name;
 }
 
 QString AppEntry::comment() const {
-    if (!m_entry) {
-        return "";
-    }
-    return m_entry->property("comment").toString();
+    return m_data.comment;
 }
 
 QString AppEntry::execString() const {
-    if (!m_entry) {
-        return "";
-    }
-    return m_entry->property("execString").toString();
+    return m_data.execString;
 }
 
 QString AppEntry::startupClass() const {
-    if (!m_entry) {
-        return "";
-    }
-    return m_entry->property("startupClass").toString();
+    return m_data.startupClass;
 }
 
 QString AppEntry::genericName() const {
-    if (!m_entry) {
-        return "";
-    }
-    return m_entry->property("genericName").toString();
+    return m_data.genericName;
 }
 
 QString AppEntry::categories() const {
+    return m_data.categories;
+}
+
+QString AppEntry::keywords() const {
+    return m_data.keywords;
+}
+
+const QString* AppEntry::searchKey(QByteArrayView name) const {
+    if (name == "id") {
+        return &m_data.id;
+    }
+    if (name == "name") {
+        return &m_data.name;
+    }
+    if (name == "comment") {
+        return &m_data.comment;
+    }
+    if (name == "execString") {
+        return &m_data.execString;
+    }
+    if (name == "startupClass") {
+        return &m_data.startupClass;
+    }
+    if (name == "genericName") {
+        return &m_data.genericName;
+    }
+    if (name == "categories") {
+        return &m_data.categories;
+    }
+    if (name == "keywords") {
+        return &m_data.keywords;
+    }
+    return nullptr;
+}
+
+QString AppEntry::readString(const char* name) const {
     if (!m_entry) {
         return "";
     }
-    return m_entry->property("categories").toStringList().join(" ");
+    return m_entry->property(name).toString();
 }
 
-QString AppEntry::keywords() const {
+QString AppEntry::readList(const char* name) const {
     if (!m_entry) {
         return "";
     }
-    return m_entry->property("keywords").toStringList().join(" ");
+    return m_entry->property(name).toStringList().join(" ");
 }
 
 AppDb::AppDb(QObject* parent)
     : QObject(parent)
     , m_timer(new QTimer(this))
-    , m_uuid(QUuid::createUuid().toString()) {
+    , m_flushTimer(new QTimer(this))
+    , m_uuid(QUuid::createUuid().toString())
+    , m_rankingMode(Frequency)
+    , m_model(nullptr) {
     m_timer->setSingleShot(true);
     m_timer->setInterval(300);
     QObject::connect(m_timer, &QTimer::timeout, this, &AppDb::updateApps);
 
-    auto db = QSqlDatabase::addDatabase("QSQLITE", m_uuid);
-    db.setDatabaseName(":memory:");
-    db.open();
+    // Launches are written back in batches. Other instances may share the db, so they are merged into whatever is
+    // stored by then rather than overwriting it.
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(5000);
+    QObject::connect(m_flushTimer, &QTimer::timeout, this, &AppDb::flushUsage);
 
-    QSqlQuery query(db);
-    query.exec("CREATE TABLE IF NOT EXISTS frequencies (id TEXT PRIMARY KEY, frequency INTEGER)");
+    QSqlDatabase::addDatabase("QSQLITE", m_uuid);
+    openDatabase(":memory:");
+
+    m_model = new AppListModel(this);
+}
+
+AppDb::~AppDb() {
+    flushUsage();
 }
 
 QString AppDb::uuid() const {
@@ -139,15 +257,11 @@ void AppDb::setPath(const QString& path) {
     m_path = newPath;
     emit pathChanged();
 
-    auto db = QSqlDatabase::database(m_uuid, false);
-    db.close();
-    db.setDatabaseName(newPath);
-    db.open();
+    // Pending launches belong to the old db
+    flushUsage();
+    openDatabase(newPath);
 
-    QSqlQuery query(db);
-    query.exec("CREATE TABLE IF NOT EXISTS frequencies (id TEXT PRIMARY KEY, frequency INTEGER)");
-
-    updateAppFrequencies();
+    updateAppUsage();
 }
 
 QObjectList AppDb::entries() const {
@@ -187,6 +301,7 @@ void AppDb::setFavouriteApps(const QStringList& favApps) {
         }
     }
 
+    sortApps();
     emit appsChanged();
 }
 
@@ -198,26 +313,49 @@ QString AppDb::regexifyString(const QString& original) const {
     return QStringLiteral("^%1$").arg(escaped);
 }
 
+AppDb::RankingMode AppDb::rankingMode() const {
+    return m_rankingMode;
+}
+
+void AppDb::setRankingMode(RankingMode mode) {
+    if (m_rankingMode == mode) {
+        return;
+    }
+
+    m_rankingMode = mode;
+    emit rankingModeChanged();
+
+    sortApps();
+    emit appsChanged();
+}
+
 QQmlListProperty<AppEntry> AppDb::apps() {
-    return QQmlListProperty<AppEntry>(this, &getSortedApps());
+    return QQmlListProperty<AppEntry>(this, &m_sortedApps);
+}
+
+const QList<AppEntry*>& AppDb::sortedApps() const {
+    return m_sortedApps;
+}
+
+AppListModel* AppDb::model() const {
+    return m_model;
 }
 
 void AppDb::incrementFrequency(const QString& id) {
-    auto db = QSqlDatabase::database(m_uuid);
-    QSqlQuery query(db);
+    auto& usage = m_usage[id];
+    usage = recordLaunch(usage, QDateTime::currentSecsSinceEpoch());
 
-    query.prepare("INSERT INTO frequencies (id, frequency) "
-                  "VALUES (:id, 1) "
-                  "ON CONFLICT (id) DO UPDATE SET frequency = frequency + 1");
-    query.bindValue(":id", id);
-    query.exec();
+    m_pendingLaunches[id].append(usage.lastUsed);
+    if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
 
     auto* app = m_apps.value(id);
     if (app) {
-        const auto before = getSortedApps();
-        app->incrementFrequency();
-        getSortedApps();
-        if (before != m_sortedApps) {
+        app->setUsage(usage);
+        const bool moved = repositionApp(app);
+        emit appUpdated(static_cast<int>(rowOf(app)));
+        if (moved) {
             emit appsChanged();
         }
     } else {
@@ -225,27 +363,18 @@ void AppDb::incrementFrequency(const QString& id) {
     }
 }
 
-QList<AppEntry*>& AppDb::getSortedApps() const {
-    m_sortedApps = m_apps.values();
-
-    // Pre-compute favourite status to avoid repeated regex matching during sort
-    QSet<QString> favSet;
-    favSet.reserve(m_sortedApps.size());
-    for (const auto* app : std::as_const(m_sortedApps)) {
-        if (isFavourite(app))
-            favSet.insert(app->id());
-    }
-
-    std::sort(m_sortedApps.begin(), m_sortedApps.end(), [&favSet](AppEntry* a, AppEntry* b) {
-        const bool aIsFav = favSet.contains(a->id());
-        const bool bIsFav = favSet.contains(b->id());
-        if (aIsFav != bIsFav)
-            return aIsFav;
-        if (a->frequency() != b->frequency())
-            return a->frequency() > b->frequency();
-        return a->name().localeAwareCompare(b->name()) < 0;
-    });
-    return m_sortedApps;
+bool AppDb::RankKey::operator<(const RankKey& other) const {
+    if (favourite != other.favourite) {
+        return favourite;
+    }
+    if (rank > other.rank || rank < other.rank) {
+        return rank > other.rank;
+    }
+    const int cmp = name.compare(other.name);
+    if (cmp != 0) {
+        return cmp < 0;
+    }
+    return id < other.id;
 }
 
 bool AppDb::isFavourite(const AppEntry* app) const {
@@ -257,31 +386,239 @@ bool AppDb::isFavourite(const AppEntry* app) const {
     return false;
 }
 
-quint32 AppDb::getFrequency(const QString& id) const {
-    auto db = QSqlDatabase::database(m_uuid);
+AppDb::RankKey AppDb::rankKey(const AppEntry* app, bool favourite) const {
+    const auto& usage = app->usage();
+
+    qreal rank = 0;
+    switch (m_rankingMode) {
+    case Frequency:
+        rank = usage.frequency;
+        break;
+    case Frecency:
+        rank = usage.frecency;
+        break;
+    case Recent:
+        rank = static_cast<qreal>(usage.lastUsed);
+        break;
+    }
+
+    return { favourite, rank, m_collator.sortKey(app->name()), app->id() };
+}
+
+qsizetype AppDb::insertionRow(const RankKey& key) const {
+    const auto it = std::upper_bound(m_sortedApps.cbegin(), m_sortedApps.cend(), key,
+        [this](const RankKey& k, const AppEntry* app) {
+            return k < m_rankKeys.at(app);
+        });
+    return it - m_sortedApps.cbegin();
+}
+
+qsizetype AppDb::rowOf(const AppEntry* app) const {
+    // Keys are unique thanks to the id, so this lands exactly on the app
+    const auto& key = m_rankKeys.at(app);
+    const auto it = std::lower_bound(m_sortedApps.cbegin(), m_sortedApps.cend(), key,
+        [this](const AppEntry* a, const RankKey& k) {
+            return m_rankKeys.at(a) < k;
+        });
+    return it - m_sortedApps.cbegin();
+}
+
+void AppDb::insertApp(AppEntry* app) {
+    auto key = rankKey(app, isFavourite(app));
+    const auto row = insertionRow(key);
+    m_rankKeys.insert_or_assign(app, std::move(key));
+    m_sortedApps.insert(row, app);
+    emit appInserted(static_cast<int>(row), app);
+}
+
+void AppDb::removeApp(const AppEntry* app) {
+    if (!m_rankKeys.contains(app)) {
+        return;
+    }
+
+    const auto row = rowOf(app);
+    m_sortedApps.removeAt(row);
+    m_rankKeys.erase(app);
+    emit appRemoved(static_cast<int>(row));
+}
+
+bool AppDb::repositionApp(AppEntry* app) {
+    const auto keyIt = m_rankKeys.find(app);
+    if (keyIt == m_rankKeys.end()) {
+        return false;
+    }
+
+    const auto from = rowOf(app);
+    m_sortedApps.removeAt(from);
+
+    // The favourite flag only changes with the favourites list, which resorts everything anyway
+    keyIt->second = rankKey(app, keyIt->second.favourite);
+    const auto to = insertionRow(keyIt->second);
+    m_sortedApps.insert(to, app);
+
+    if (from == to) {
+        return false;
+    }
+
+    emit appMoved(static_cast<int>(from), static_cast<int>(to));
+    return true;
+}
+
+void AppDb::sortApps() {
+    m_rankKeys.clear();
+    for (const auto* app : std::as_const(m_sortedApps)) {
+        m_rankKeys.insert_or_assign(app, rankKey(app, isFavourite(app)));
+    }
+
+    std::sort(m_sortedApps.begin(), m_sortedApps.end(), [this](const AppEntry* a, const AppEntry* b) {
+        return m_rankKeys.at(a) < m_rankKeys.at(b);
+    });
+
+    emit appsReset();
+}
+
+void AppDb::openDatabase(const QString& name) {
+    // The statements hold on to the old connection
+    m_readQuery = QSqlQuery();
+    m_writeQuery = QSqlQuery();
+    m_usage.clear();
+
+    auto db = QSqlDatabase::database(m_uuid, false);
+    db.close();
+    db.setDatabaseName(name);
+    if (!db.open()) {
+        qCWarning(lcAppDb) << "openDatabase: failed to open database" << name;
+        return;
+    }
+
     QSqlQuery query(db);
+    query.exec("PRAGMA journal_mode = WAL");
+    query.exec("PRAGMA synchronous = NORMAL");
+    query.exec("CREATE TABLE IF NOT EXISTS frequencies (id TEXT PRIMARY KEY, frequency INTEGER)");
+
+    // Older dbs only have the launch count
+    QSet<QString> columns;
+    if (query.exec("PRAGMA table_info(frequencies)")) {
+        while (query.next()) {
+            columns.insert(query.value(1).toString());
+        }
+    }
+    if (!columns.contains("last_used")) {
+        query.exec("ALTER TABLE frequencies ADD COLUMN last_used INTEGER NOT NULL DEFAULT 0");
+    }
+    if (!columns.contains("frecency")) {
+        query.exec("ALTER TABLE frequencies ADD COLUMN frecency REAL");
+    }
+
+    m_readQuery = QSqlQuery(db);
+    m_readQuery.prepare("SELECT frequency, last_used, frecency FROM frequencies WHERE id = :id");
+    m_writeQuery = QSqlQuery(db);
+    m_writeQuery.prepare("INSERT INTO frequencies (id, frequency, last_used, frecency) "
+                         "VALUES (:id, :launches, :lastUsed, :frecency) "
+                         "ON CONFLICT (id) DO UPDATE SET frequency = COALESCE(frequency, 0) + excluded.frequency, "
+                         "last_used = MAX(last_used, excluded.last_used), frecency = excluded.frecency");
+
+    if (!query.exec("SELECT id, frequency, last_used, frecency FROM frequencies")) {
+        qCWarning(lcAppDb) << "openDatabase: failed to load frequencies";
+        return;
+    }
 
-    query.prepare("SELECT frequency FROM frequencies WHERE id = :id");
-    query.bindValue(":id", id);
+    const qreal now = halfLives(QDateTime::currentSecsSinceEpoch());
+    QList<std::pair<QString, qreal>> seeds;
+    while (query.next()) {
+        const auto id = query.value(0).toString();
+        AppUsage usage;
+        usage.frequency = query.value(1).toUInt();
+        usage.lastUsed = query.value(2).toLongLong();
+
+        if (!query.value(3).isNull()) {
+            usage.frecency = query.value(3).toDouble();
+        } else if (usage.frequency > 0) {
+            // No history from before frecency was tracked, treat the old count as if it was fresh so it starts
+            // decaying from here
+            usage.frecency = std::log2(static_cast<qreal>(usage.frequency)) + now;
+            seeds.append({ id, usage.frecency });
+        }
 
-    if (query.exec() && query.next()) {
-        return query.value(0).toUInt();
+        m_usage.insert(id, usage);
     }
 
-    return 0;
+    if (!seeds.isEmpty()) {
+        // Only fills in rows nobody else has seeded or launched since, so it never replaces newer scores
+        db.transaction();
+        query.prepare("UPDATE frequencies SET frecency = :frecency WHERE id = :id AND frecency IS NULL");
+        for (const auto& [id, frecency] : std::as_const(seeds)) {
+            query.bindValue(":id", id);
+            query.bindValue(":frecency", frecency);
+            if (!query.exec()) {
+                qCWarning(lcAppDb) << "openDatabase: failed to seed frecency for" << id;
+            }
+        }
+        db.commit();
+    }
 }
 
-void AppDb::updateAppFrequencies() {
-    const auto before = getSortedApps();
+void AppDb::flushUsage() {
+    m_flushTimer->stop();
+    if (m_pendingLaunches.isEmpty()) {
+        return;
+    }
 
-    for (auto* app : std::as_const(m_apps)) {
-        app->setFrequency(getFrequency(app->id()));
+    auto db = QSqlDatabase::database(m_uuid, false);
+    if (!db.isOpen()) {
+        m_pendingLaunches.clear();
+        return;
     }
 
-    getSortedApps();
-    if (before != m_sortedApps) {
-        emit appsChanged();
+    // One transaction for the whole batch, so only one sync. Taking the write lock up front keeps the stored rows
+    // from changing between reading and writing them.
+    QSqlQuery transaction(db);
+    if (!transaction.exec("BEGIN IMMEDIATE")) {
+        qCWarning(lcAppDb) << "flushUsage: failed to start transaction, retrying later";
+        m_flushTimer->start();
+        return;
     }
+
+    for (auto it = m_pendingLaunches.cbegin(); it != m_pendingLaunches.cend(); ++it) {
+        // Replay the launches on top of the stored row, which another instance may have updated since we loaded it
+        AppUsage stored;
+        m_readQuery.bindValue(":id", it.key());
+        if (m_readQuery.exec() && m_readQuery.next()) {
+            stored.frequency = m_readQuery.value(0).toUInt();
+            stored.lastUsed = m_readQuery.value(1).toLongLong();
+            if (!m_readQuery.value(2).isNull()) {
+                stored.frecency = m_readQuery.value(2).toDouble();
+            }
+        }
+        m_readQuery.finish();
+
+        for (const qint64 time : it.value()) {
+            stored = recordLaunch(stored, time);
+        }
+
+        m_writeQuery.bindValue(":id", it.key());
+        m_writeQuery.bindValue(":launches", it.value().size());
+        m_writeQuery.bindValue(":lastUsed", stored.lastUsed);
+        m_writeQuery.bindValue(":frecency", stored.frecency);
+        if (!m_writeQuery.exec()) {
+            qCWarning(lcAppDb) << "flushUsage: failed to write usage for" << it.key();
+        }
+    }
+
+    if (!transaction.exec("COMMIT")) {
+        qCWarning(lcAppDb) << "flushUsage: failed to commit usage";
+    }
+
+    m_pendingLaunches.clear();
+}
+
+void AppDb::updateAppUsage() {
+    for (auto* app : std::as_const(m_apps)) {
+        app->setUsage(m_usage.value(app->id()));
+    }
+
+    sortApps();
+    emit appsChanged();
 }
 
 void AppDb::updateApps() {
@@ -291,13 +628,26 @@ void AppDb::updateApps() {
         const auto id = entry->property("id").toString();
         if (!m_apps.contains(id)) {
             dirty = true;
-            auto* const newEntry = new AppEntry(entry, getFrequency(id), this);
-            QObject::connect(newEntry, &QObject::destroyed, this, [id, this]() {
-                if (m_apps.remove(id)) {
+            auto* const newEntry = new AppEntry(entry, m_usage.value(id), this);
+            QObject::connect(newEntry, &QObject::destroyed, this, [id, newEntry, this]() {
+                removeApp(newEntry);
+                if (m_apps.value(id) == newEntry && m_apps.remove(id)) {
+                    emit appsChanged();
+                }
+            });
+            QObject::connect(newEntry, &AppEntry::nameChanged, this, [newEntry, this]() {
+                if (!m_rankKeys.contains(newEntry)) {
+                    return;
+                }
+
+                const bool moved = repositionApp(newEntry);
+                emit appUpdated(static_cast<int>(rowOf(newEntry)));
+                if (moved) {
                     emit appsChanged();
                 }
             });
             m_apps.insert(id, newEntry);
+            insertApp(newEntry);
         }
     }
 
@@ -309,6 +659,7 @@ void AppDb::updateApps() {
     for (auto it = m_apps.begin(); it != m_apps.end();) {
         if (!newIds.contains(it.key())) {
             dirty = true;
+            removeApp(it.value());
             it.value()->deleteLater();
             it = m_apps.erase(it);
         } else {
@@ -1,16 +1,33 @@
 #pragma once
 
+#include "applistmodel.hpp"
+#include "fuzzymatcher.hpp"
+#include <qcollator.h>
+#include <qdatetime.h>
 #include <qhash.h>
+#include <qnumeric.h>
 #include <qobject.h>
 #include <qqmlintegration.h>
 #include <qqmllist.h>
 #include <qregularexpression.h>
+#include <qset.h>
+#include <qsqlquery.h>
 #include <qtimer.h>
+#include <unordered_map>
 
 namespace caelestia {
 
-class AppEntry : public QObject {
+// Launch history of an app. Frecency is log2 of the decayed score carried back to the epoch, so comparing two apps
+// never depends on the current time and nothing needs decaying as time passes.
+struct AppUsage {
+    quint32 frequency = 0;
+    qint64 lastUsed = 0; // seconds since the epoch
+    qreal frecency = -qInf();
+};
+
+class AppEntry : public QObject, public SearchKeySource {
     Q_OBJECT
+    Q_INTERFACES(caelestia::SearchKeySource)
     QML_ELEMENT
     QML_UNCREATABLE("AppEntry instances can only be retrieved from an AppDb")
 
@@ -18,6 +35,8 @@ class AppEntry : public QObject {
     Q_PROPERTY(QObject* entry READ entry CONSTANT)
 
     Q_PROPERTY(quint32 frequency READ frequency NOTIFY frequencyChanged)
+    Q_PROPERTY(QDateTime lastUsed READ lastUsed NOTIFY lastUsedChanged)
+    Q_PROPERTY(qreal frecency READ frecency NOTIFY frecencyChanged)
     Q_PROPERTY(QString id READ id CONSTANT)
     Q_PROPERTY(QString name READ name NOTIFY nameChanged)
     Q_PROPERTY(QString comment READ comment NOTIFY commentChanged)
@@ -28,13 +47,16 @@ class AppEntry : public QObject {
     Q_PROPERTY(QString keywords READ keywords NOTIFY keywordsChanged)
 
 public:
-    explicit AppEntry(QObject* entry, quint32 frequency, QObject* parent = nullptr);
+    explicit AppEntry(QObject* entry, const AppUsage& usage, QObject* parent = nullptr);
 
     [[nodiscard]] QObject* entry() const;
 
+    [[nodiscard]] const AppUsage& usage() const;
+    void setUsage(const AppUsage& usage);
+
     [[nodiscard]] quint32 frequency() const;
-    void setFrequency(quint32 frequency);
-    void incrementFrequency();
+    [[nodiscard]] QDateTime lastUsed() const;
+    [[nodiscard]] qreal frecency() const; // decayed to now
 
     [[nodiscard]] QString id() const;
     [[nodiscard]] QString name() const;
@@ -45,8 +67,13 @@ public:
     [[nodiscard]] QString categories() const;
     [[nodiscard]] QString keywords() const;
 
+    // The snapshot of a property by name, or null if it isn't one of the forwarded ones
+    [[nodiscard]] const QString* searchKey(QByteArrayView name) const override;
+
 signals:
     void frequencyChanged();
+    void lastUsedChanged();
+    void frecencyChanged();
     void nameChanged();
     void commentChanged();
     void execStringChanged();
@@ -56,8 +83,24 @@ signals:
     void keywordsChanged();
 
 private:
+    // Copies of the entry's properties, refreshed when it notifies so getters never go through QVariant
+    struct Snapshot {
+        QString id;
+        QString name;
+        QString comment;
+        QString execString;
+        QString startupClass;
+        QString genericName;
+        QString categories; // joined with spaces
+        QString keywords;   // joined with spaces
+    };
+
     QObject* m_entry;
-    quint32 m_frequency;
+    AppUsage m_usage;
+    Snapshot m_data;
+
+    [[nodiscard]] QString readString(const char* name) const;
+    [[nodiscard]] QString readList(const char* name) const;
 };
 
 class AppDb : public QObject {
@@ -68,10 +111,20 @@ class AppDb : public QObject {
     Q_PROPERTY(QString path READ path WRITE setPath NOTIFY pathChanged REQUIRED)
     Q_PROPERTY(QObjectList entries READ entries WRITE setEntries NOTIFY entriesChanged REQUIRED)
     Q_PROPERTY(QStringList favouriteApps READ favouriteApps WRITE setFavouriteApps NOTIFY favouriteAppsChanged REQUIRED)
+    Q_PROPERTY(RankingMode rankingMode READ rankingMode WRITE setRankingMode NOTIFY rankingModeChanged)
     Q_PROPERTY(QQmlListProperty<caelestia::AppEntry> apps READ apps NOTIFY appsChanged)
+    Q_PROPERTY(caelestia::AppListModel* model READ model CONSTANT)
 
 public:
+    enum RankingMode {
+        Frequency,
+        Frecency,
+        Recent
+    };
+    Q_ENUM(RankingMode)
+
     explicit AppDb(QObject* parent = nullptr);
+    ~AppDb() override;
 
     [[nodiscard]] QString uuid() const;
 
@@ -84,7 +137,12 @@ public:
     [[nodiscard]] QStringList favouriteApps() const;
     void setFavouriteApps(const QStringList& favApps);
 
+    [[nodiscard]] RankingMode rankingMode() const;
+    void setRankingMode(RankingMode mode);
+
     [[nodiscard]] QQmlListProperty<AppEntry> apps();
+    [[nodiscard]] const QList<AppEntry*>& sortedApps() const;
+    [[nodiscard]] AppListModel* model() const;
 
     Q_INVOKABLE void incrementFrequency(const QString& id);
 
@@ -92,24 +150,58 @@ signals:
     void pathChanged();
     void entriesChanged();
     void favouriteAppsChanged();
+    void rankingModeChanged();
     void appsChanged();
 
+    // Finer grained changes to apps, each comes before the matching appsChanged
+    void appInserted(int row, caelestia::AppEntry* app);
+    void appRemoved(int row);
+    void appMoved(int from, int to);
+    void appUpdated(int row);
+    void appsReset();
+
 private:
+    // Snapshot of everything an app is ordered by, so it can still be found after it changes
+    struct RankKey {
+        bool favourite;
+        qreal rank;
+        QCollatorSortKey name;
+        QString id;
+
+        bool operator<(const RankKey& other) const;
+    };
+
     QTimer* m_timer;
+    QTimer* m_flushTimer;
 
     const QString m_uuid;
     QString m_path;
     QObjectList m_entries;
     QStringList m_favouriteApps;                    // unedited string list from qml
     QList<QRegularExpression> m_favouriteAppsRegex; // pre-regexified m_favouriteApps list
+    RankingMode m_rankingMode;
+    QCollator m_collator;
     QHash<QString, AppEntry*> m_apps;
-    mutable QList<AppEntry*> m_sortedApps;
+    QList<AppEntry*> m_sortedApps; // always kept in order
+    std::unordered_map<const AppEntry*, RankKey> m_rankKeys;
+    AppListModel* m_model;
+    QHash<QString, AppUsage> m_usage; // everything in the db, loaded in one go when it is opened
+    QHash<QString, QList<qint64>> m_pendingLaunches; // launch times not yet written back
+    QSqlQuery m_readQuery;
+    QSqlQuery m_writeQuery;
 
     QString regexifyString(const QString& original) const;
-    QList<AppEntry*>& getSortedApps() const;
     bool isFavourite(const AppEntry* app) const;
-    quint32 getFrequency(const QString& id) const;
-    void updateAppFrequencies();
+    RankKey rankKey(const AppEntry* app, bool favourite) const;
+    qsizetype insertionRow(const RankKey& key) const;
+    qsizetype rowOf(const AppEntry* app) const;
+    void insertApp(AppEntry* app);
+    void removeApp(const AppEntry* app);
+    bool repositionApp(AppEntry* app);
+    void sortApps();
+    void openDatabase(const QString& name);
+    void flushUsage();
+    void updateAppUsage();
     void updateApps();
 };
 
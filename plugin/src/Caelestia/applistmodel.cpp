@@ -0,0 +1,78 @@
+#include "applistmodel.hpp"
+
+#include "appdb.hpp"
+
+namespace caelestia {
+
+AppListModel::AppListModel(AppDb* db)
+    : QAbstractListModel(db)
+    , m_db(db)
+    , m_apps(db->sortedApps()) {
+    connect(db, &AppDb::appInserted, this, &AppListModel::insertApp);
+    connect(db, &AppDb::appRemoved, this, &AppListModel::removeApp);
+    connect(db, &AppDb::appMoved, this, &AppListModel::moveApp);
+    connect(db, &AppDb::appUpdated, this, &AppListModel::updateApp);
+    connect(db, &AppDb::appsReset, this, &AppListModel::reset);
+}
+
+int AppListModel::count() const {
+    return static_cast<int>(m_apps.size());
+}
+
+int AppListModel::rowCount(const QModelIndex& parent) const {
+    if (parent != QModelIndex()) {
+        return 0;
+    }
+    return static_cast<int>(m_apps.size());
+}
+
+QVariant AppListModel::data(const QModelIndex& index, int role) const {
+    if (role != Qt::UserRole || !index.isValid() || index.row() >= m_apps.size()) {
+        return QVariant();
+    }
+    return QVariant::fromValue(m_apps.at(index.row()));
+}
+
+QHash<int, QByteArray> AppListModel::roleNames() const {
+    return { { Qt::UserRole, "modelData" } };
+}
+
+void AppListModel::insertApp(int row, AppEntry* app) {
+    beginInsertRows(QModelIndex(), row, row);
+    m_apps.insert(row, app);
+    endInsertRows();
+    emit countChanged();
+}
+
+void AppListModel::removeApp(int row) {
+    beginRemoveRows(QModelIndex(), row, row);
+    m_apps.removeAt(row);
+    endRemoveRows();
+    emit countChanged();
+}
+
+void AppListModel::moveApp(int from, int to) {
+    // The destination is the row to insert before, counted before the move
+    beginMoveRows(QModelIndex(), from, from, QModelIndex(), to > from ? to + 1 : to);
+    m_apps.move(from, to);
+    endMoveRows();
+}
+
+void AppListModel::updateApp(int row) {
+    const auto idx = index(row);
+    emit dataChanged(idx, idx);
+}
+
+void AppListModel::reset() {
+    const bool countChanging = m_apps.size() != m_db->sortedApps().size();
+
+    beginResetModel();
+    m_apps = m_db->sortedApps();
+    endResetModel();
+
+    if (countChanging) {
+        emit countChanged();
+    }
+}
+
+} // namespace caelestia
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <qabstractitemmodel.h>
+#include <qobject.h>
+#include <qqmlintegration.h>
+
+namespace caelestia {
+
+class AppDb;
+class AppEntry;
+
+// The apps of an AppDb in order, with a row level signal for every change so views only touch what moved
+class AppListModel : public QAbstractListModel {
+    Q_OBJECT
+    QML_ELEMENT
+    QML_UNCREATABLE("AppListModel instances can only be retrieved from an AppDb")
+
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    explicit AppListModel(AppDb* db);
+
+    [[nodiscard]] int count() const;
+
+    [[nodiscard]] int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    [[nodiscard]] QVariant data(const QModelIndex& index, int role = Qt::UserRole) const override;
+    [[nodiscard]] QHash<int, QByteArray> roleNames() const override;
+
+signals:
+    void countChanged();
+
+private:
+    AppDb* m_db;
+    QList<AppEntry*> m_apps;
+
+    void insertApp(int row, AppEntry* app);
+    void removeApp(int row);
+    void moveApp(int from, int to);
+    void updateApp(int row);
+    void reset();
+};
+
+} // namespace caelestia
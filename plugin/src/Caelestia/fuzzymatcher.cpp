@@ -0,0 +1,489 @@
+#include "fuzzymatcher.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CAELESTIA_FUZZY_X86
+#include <immintrin.h>
+#endif
+
+namespace caelestia {
+
+namespace {
+
+// Scoring constants from fzf's v2 algorithm
+constexpr int SCORE_MATCH = 16;
+constexpr int SCORE_GAP_START = -3;
+constexpr int SCORE_GAP_EXTENSION = -1;
+constexpr int BONUS_BOUNDARY = SCORE_MATCH / 2;
+constexpr int BONUS_NON_WORD = SCORE_MATCH / 2;
+constexpr int BONUS_CAMEL_123 = BONUS_BOUNDARY + SCORE_GAP_EXTENSION;
+constexpr int BONUS_CONSECUTIVE = -(SCORE_GAP_START + SCORE_GAP_EXTENSION);
+constexpr int BONUS_FIRST_CHAR_MULTIPLIER = 2;
+
+enum CharClass {
+    NonWord,
+    Lower,
+    Upper,
+    Letter,
+    Number
+};
+
+CharClass charClass(QChar ch) {
+    const char16_t c = ch.unicode();
+    if (c >= u'a' && c <= u'z') {
+        return Lower;
+    }
+    if (c >= u'A' && c <= u'Z') {
+        return Upper;
+    }
+    if (c >= u'0' && c <= u'9') {
+        return Number;
+    }
+    if (c < 0x80) {
+        return NonWord;
+    }
+
+    if (ch.isLower()) {
+        return Lower;
+    }
+    if (ch.isUpper()) {
+        return Upper;
+    }
+    if (ch.isNumber()) {
+        return Number;
+    }
+    if (ch.isLetter()) {
+        return Letter;
+    }
+    return NonWord;
+}
+
+int bonusFor(CharClass prev, CharClass curr) {
+    if (prev == NonWord && curr != NonWord) {
+        return BONUS_BOUNDARY;
+    }
+    if ((prev == Lower && curr == Upper) || (prev != Number && curr == Number)) {
+        return BONUS_CAMEL_123;
+    }
+    if (curr == NonWord) {
+        return BONUS_NON_WORD;
+    }
+    return 0;
+}
+
+// Strips diacritics from latin letters so e matches é
+char16_t fold(char16_t c) {
+    if (c < 0x80) {
+        return c;
+    }
+
+    const QChar ch(c);
+    if (ch.decompositionTag() == QChar::Canonical) {
+        const QString decomposed = ch.decomposition();
+        if (!decomposed.isEmpty() && decomposed.at(0).unicode() < 0x80) {
+            return decomposed.at(0).unicode();
+        }
+    }
+    return c;
+}
+
+char16_t toLower(char16_t c) {
+    if (c < 0x80) {
+        return c >= u'A' && c <= u'Z' ? static_cast<char16_t>(c + (u'a' - u'A')) : c;
+    }
+    return QChar(c).toLower().unicode();
+}
+
+// One bit per letter and digit, everything else shares the remaining bits. A candidate can only match if it has
+// every bit the query has.
+quint64 maskBit(char16_t c) {
+    if (c >= u'a' && c <= u'z') {
+        return 1ULL << (c - u'a');
+    }
+    if (c >= u'0' && c <= u'9') {
+        return 1ULL << (26 + c - u'0');
+    }
+    if (c < 0x80) {
+        return 1ULL << (36 + c % 16);
+    }
+    return 1ULL << (52 + c % 12);
+}
+
+// Sets bit i of bits for each candidate in [begin, end) whose mask contains every bit of mask. Candidates are
+// indices[i] when given, i otherwise.
+using MaskTester = void (*)(const quint64* masks, const quint32* indices, size_t begin, size_t end, quint64 mask,
+    quint64* bits);
+
+namespace scalar {
+
+void testMasks(const quint64* masks, const quint32* indices, size_t begin, size_t end, quint64 mask, quint64* bits) {
+    for (size_t i = begin; i < end; ++i) {
+        const quint64 candidate = masks[indices ? indices[i] : i];
+        bits[i / 64] |= static_cast<quint64>((candidate & mask) == mask) << (i % 64);
+    }
+}
+
+} // namespace scalar
+
+#ifdef CAELESTIA_FUZZY_X86
+
+namespace sse2 {
+
+__attribute__((target("sse2"))) void testMasks(
+    const quint64* masks, const quint32* indices, size_t begin, size_t end, quint64 mask, quint64* bits) {
+    const __m128i want = _mm_set1_epi64x(static_cast<long long>(mask));
+    size_t i = begin;
+    for (; i + 2 <= end; i += 2) {
+        const __m128i m = indices ? _mm_set_epi64x(static_cast<long long>(masks[indices[i + 1]]),
+                                        static_cast<long long>(masks[indices[i]]))
+                                  : _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks + i));
+        // No 64 bit compare before SSE4.1, so both 32 bit halves have to match
+        const __m128i eq = _mm_cmpeq_epi32(_mm_and_si128(m, want), want);
+        const __m128i both = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+        const auto found = static_cast<quint64>(_mm_movemask_pd(_mm_castsi128_pd(both)));
+        bits[i / 64] |= found << (i % 64);
+    }
+    scalar::testMasks(masks, indices, i, end, mask, bits);
+}
+
+} // namespace sse2
+
+namespace avx2 {
+
+__attribute__((target("avx2"))) void testMasks(
+    const quint64* masks, const quint32* indices, size_t begin, size_t end, quint64 mask, quint64* bits) {
+    const __m256i want = _mm256_set1_epi64x(static_cast<long long>(mask));
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        const __m256i m = indices
+                            ? _mm256_i32gather_epi64(reinterpret_cast<const long long*>(masks),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i)), 8)
+                            : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + i));
+        const __m256i eq = _mm256_cmpeq_epi64(_mm256_and_si256(m, want), want);
+        const auto found = static_cast<quint64>(_mm256_movemask_pd(_mm256_castsi256_pd(eq)));
+        bits[i / 64] |= found << (i % 64);
+    }
+    sse2::testMasks(masks, indices, i, end, mask, bits);
+}
+
+} // namespace avx2
+
+#endif
+
+MaskTester detectMaskTester() {
+#ifdef CAELESTIA_FUZZY_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2::testMasks;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return sse2::testMasks;
+    }
+#endif
+    return scalar::testMasks;
+}
+
+MaskTester maskTester() {
+    static const MaskTester selected = detectMaskTester();
+    return selected;
+}
+
+} // namespace
+
+QList<QStringList> FuzzyMatcher::readKeys(const QObjectList& items, const QStringList& keys) {
+    QList<QByteArray> names;
+    names.reserve(keys.size());
+    for (const auto& key : keys) {
+        names << key.toUtf8();
+    }
+
+    QList<QStringList> values;
+    values.reserve(items.size());
+    for (const auto* item : items) {
+        const auto* source = qobject_cast<const SearchKeySource*>(item);
+
+        QStringList itemValues;
+        itemValues.reserve(names.size());
+        for (const auto& name : std::as_const(names)) {
+            if (!item || name.isEmpty()) {
+                itemValues << QString();
+            } else if (const auto* field = source ? source->searchKey(name) : nullptr) {
+                itemValues << *field;
+            } else {
+                itemValues << item->property(name.constData()).toString();
+            }
+        }
+        values << itemValues;
+    }
+    return values;
+}
+
+void FuzzyMatcher::prepare(const QList<QStringList>& items, bool weighted) {
+    m_history.clear();
+    m_folded.clear();
+    m_lower.clear();
+    m_bonus.clear();
+    m_candidates.clear();
+    m_masks.clear();
+    m_lengths.clear();
+
+    m_weighted = weighted;
+    m_stride = 1;
+    if (weighted) {
+        for (const auto& values : items) {
+            m_stride = std::max(m_stride, values.size());
+        }
+    }
+
+    const auto count = static_cast<size_t>(items.size());
+    m_candidates.reserve(count * static_cast<size_t>(m_stride));
+    m_masks.reserve(count * static_cast<size_t>(m_stride));
+    m_lengths.reserve(count);
+
+    for (const auto& values : items) {
+        const QString joined = values.join(' ');
+        if (weighted) {
+            for (const auto& value : values) {
+                appendCandidate(value);
+            }
+            // Every item takes the same number of candidates so the item is just the candidate over the stride
+            for (auto i = values.size(); i < m_stride; ++i) {
+                appendCandidate(QString());
+            }
+        } else {
+            appendCandidate(joined);
+        }
+
+        m_lengths.push_back(static_cast<quint32>(joined.trimmed().size()));
+    }
+}
+
+bool FuzzyMatcher::match(const QString& query, const QList<qreal>& weights, std::vector<Match>& matches,
+    const std::function<bool()>& cancelled) {
+    // Smart case, only care about case when the query has some upper case in it
+    const QString normalised = query.normalized(QString::NormalizationForm_C);
+    std::u16string pattern;
+    pattern.reserve(static_cast<size_t>(normalised.size()));
+    bool caseSensitive = false;
+    quint64 mask = 0;
+    for (const QChar ch : normalised) {
+        const char16_t folded = fold(ch.unicode());
+        const char16_t lower = toLower(folded);
+        caseSensitive |= folded != lower;
+        pattern.push_back(folded);
+        mask |= maskBit(lower);
+    }
+    if (!caseSensitive) {
+        std::transform(pattern.begin(), pattern.end(), pattern.begin(), toLower);
+    }
+
+    // Throw away steps the new query doesn't extend, a backspace lands back on one that was already scored
+    while (!m_history.empty() && !pattern.starts_with(m_history.back().pattern)) {
+        m_history.pop_back();
+    }
+
+    if (m_history.empty() || m_history.back().pattern != pattern) {
+        // Anything matching the new query also matched every prefix of it, so only rescan the last step
+        filter(m_history.empty() ? nullptr : &m_history.back().candidates, mask);
+
+        Step step;
+        step.pattern = pattern;
+        const char16_t* arena = caseSensitive ? m_folded.data() : m_lower.data();
+        m_first.resize(pattern.size());
+        for (size_t i = 0; i < m_survivors.size(); ++i) {
+            if (cancelled && i % 1024 == 0 && cancelled()) {
+                return false;
+            }
+
+            const quint32 candidate = m_survivors[i];
+            const int s =
+                score(m_candidates[candidate], arena, pattern.data(), static_cast<qsizetype>(pattern.size()));
+            if (s >= 0) {
+                step.candidates.push_back(candidate);
+                step.scores.push_back(s);
+            }
+        }
+        m_history.push_back(std::move(step));
+    }
+
+    const Step& step = m_history.back();
+    const auto stride = static_cast<quint32>(m_stride);
+    matches.clear();
+
+    // Candidates are in order, so the keys of an item are always next to each other
+    for (size_t i = 0; i < step.candidates.size(); ++i) {
+        const quint32 candidate = step.candidates[i];
+        const int s = step.scores[i];
+        const quint32 item = candidate / stride;
+        const qreal weight = m_weighted ? weights.value(candidate % stride, 1.0) : 1.0;
+        if (!matches.empty() && matches.back().index == item) {
+            matches.back().score += weight * s;
+        } else {
+            matches.push_back({ weight * s, m_lengths[item], item });
+        }
+    }
+
+    return true;
+}
+
+bool FuzzyMatcher::lessThan(const Match& a, const Match& b) {
+    if (a.score > b.score || a.score < b.score) {
+        return a.score > b.score;
+    }
+    if (a.length != b.length) {
+        return a.length < b.length;
+    }
+    return a.index < b.index;
+}
+
+void FuzzyMatcher::appendCandidate(const QString& text) {
+    const QString normalised = text.normalized(QString::NormalizationForm_C);
+    const auto offset = static_cast<quint32>(m_folded.size());
+
+    quint64 mask = 0;
+    CharClass prevClass = NonWord;
+    for (const QChar ch : normalised) {
+        const CharClass cls = charClass(ch);
+        const char16_t folded = fold(ch.unicode());
+        const char16_t lower = toLower(folded);
+
+        m_folded.push_back(folded);
+        m_lower.push_back(lower);
+        m_bonus.push_back(static_cast<qint8>(bonusFor(prevClass, cls)));
+        mask |= maskBit(lower);
+        prevClass = cls;
+    }
+
+    m_candidates.push_back({ offset, static_cast<quint32>(m_folded.size()) - offset });
+    m_masks.push_back(mask);
+}
+
+void FuzzyMatcher::filter(const std::vector<quint32>* source, quint64 mask) {
+    // Most candidates are thrown out here without touching their text. The masks are tested a vector at a time
+    // into a bitmap, then the survivors are picked out of it a set bit at a time.
+    const size_t total = source ? source->size() : m_masks.size();
+    m_bits.assign((total + 63) / 64, 0);
+    maskTester()(m_masks.data(), source ? source->data() : nullptr, 0, total, mask, m_bits.data());
+
+    m_survivors.clear();
+    for (size_t word = 0; word < m_bits.size(); ++word) {
+        for (quint64 bits = m_bits[word]; bits; bits &= bits - 1) {
+            const size_t i = word * 64 + static_cast<size_t>(std::countr_zero(bits));
+            m_survivors.push_back(source ? (*source)[i] : static_cast<quint32>(i));
+        }
+    }
+}
+
+int FuzzyMatcher::score(const Candidate& candidate, const char16_t* arena, const char16_t* pattern, qsizetype m) {
+    const auto n = static_cast<int>(candidate.length);
+    const auto patternLen = static_cast<int>(m);
+    if (patternLen > n) {
+        return -1;
+    }
+
+    const char16_t* text = arena + candidate.offset;
+    const qint8* bonus = m_bonus.data() + candidate.offset;
+
+    // First occurrence of each pattern char, any match has to start after these
+    int pidx = 0;
+    int first = 0;
+    for (; first < n && pidx < patternLen; ++first) {
+        if (text[first] == pattern[pidx]) {
+            m_first[static_cast<size_t>(pidx++)] = first;
+        }
+    }
+    if (pidx < patternLen) {
+        return -1;
+    }
+
+    // And the last occurrence of the final char, nothing after it can score
+    const char16_t lastChar = pattern[patternLen - 1];
+    int last = n - 1;
+    while (text[last] != lastChar) {
+        --last;
+    }
+
+    const int f0 = m_first[0];
+    const int width = last - f0 + 1;
+    const auto cells = static_cast<size_t>(width) * static_cast<size_t>(patternLen);
+    if (m_scores.size() < cells) {
+        m_scores.resize(cells);
+        m_consecutive.resize(cells);
+    }
+    int* scores = m_scores.data();
+    int* consecutive = m_consecutive.data();
+
+    // First row, only the first pattern char can match
+    int best = 0;
+    int prev = 0;
+    bool inGap = false;
+    for (int j = 0; j < width; ++j) {
+        const int col = f0 + j;
+        if (text[col] == pattern[0]) {
+            scores[j] = SCORE_MATCH + bonus[col] * BONUS_FIRST_CHAR_MULTIPLIER;
+            consecutive[j] = 1;
+            inGap = false;
+        } else {
+            scores[j] = std::max(prev + (inGap ? SCORE_GAP_EXTENSION : SCORE_GAP_START), 0);
+            consecutive[j] = 0;
+            inGap = true;
+        }
+        prev = scores[j];
+        best = std::max(best, scores[j]);
+    }
+
+    if (patternLen == 1) {
+        return best;
+    }
+
+    for (int p = 1; p < patternLen; ++p) {
+        const int f = m_first[static_cast<size_t>(p)];
+        const int row = p * width;
+        const char16_t pc = pattern[p];
+
+        inGap = false;
+        scores[row + f - f0 - 1] = 0;
+        for (int col = f; col <= last; ++col) {
+            const int j = col - f0;
+            const int gap = scores[row + j - 1] + (inGap ? SCORE_GAP_EXTENSION : SCORE_GAP_START);
+
+            int diagonal = 0;
+            int run = 0;
+            if (text[col] == pc) {
+                const int diag = row - width + j - 1;
+                diagonal = scores[diag] + SCORE_MATCH;
+
+                int b = bonus[col];
+                run = consecutive[diag] + 1;
+                if (b == BONUS_BOUNDARY) {
+                    run = 1;
+                } else if (run > 1) {
+                    // Consecutive chars keep the bonus of the start of the run
+                    b = std::max({ b, BONUS_CONSECUTIVE, static_cast<int>(bonus[col - run + 1]) });
+                }
+
+                if (diagonal + b < gap) {
+                    diagonal += bonus[col];
+                    run = 0;
+                } else {
+                    diagonal += b;
+                }
+            }
+
+            consecutive[row + j] = run;
+            inGap = diagonal < gap;
+            scores[row + j] = std::max({ diagonal, gap, 0 });
+        }
+    }
+
+    best = 0;
+    const int lastRow = (patternLen - 1) * width;
+    for (int j = m_first[static_cast<size_t>(patternLen - 1)] - f0; j < width; ++j) {
+        best = std::max(best, scores[lastRow + j]);
+    }
+    return best;
+}
+
+} // namespace caelestia
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <functional>
+#include <qbytearrayview.h>
+#include <qlist.h>
+#include <qobject.h>
+#include <qstringlist.h>
+#include <string>
+#include <vector>
+
+namespace caelestia {
+
+// Lets items hand over their search keys directly, saving a property lookup and a QVariant per key
+class SearchKeySource {
+public:
+    virtual ~SearchKeySource() = default;
+
+    // The value of a key, or null to fall back to reading the property
+    [[nodiscard]] virtual const QString* searchKey(QByteArrayView name) const = 0;
+};
+
+// fzf v2 style scoring over a prepared set of items. Has no thread affinity, but must only be used from one thread
+// at a time.
+class FuzzyMatcher {
+public:
+    struct Match {
+        qreal score;
+        quint32 length;
+        quint32 index;
+    };
+
+    // Reads the keys of each item, has to be done on the thread the items live in. Items implementing
+    // SearchKeySource are asked first.
+    [[nodiscard]] static QList<QStringList> readKeys(const QObjectList& items, const QStringList& keys);
+
+    // Weighted items score each key on its own, otherwise the keys are joined into one candidate like fzf's selector
+    void prepare(const QList<QStringList>& items, bool weighted);
+
+    // One unsorted match per matching item. Returns false and leaves matches alone if cancelled part way through.
+    bool match(const QString& query, const QList<qreal>& weights, std::vector<Match>& matches,
+        const std::function<bool()>& cancelled = nullptr);
+
+    // Best score first, then the shortest text, then item order
+    [[nodiscard]] static bool lessThan(const Match& a, const Match& b);
+
+private:
+    struct Candidate {
+        quint32 offset;
+        quint32 length;
+    };
+
+    // Candidates matching a query and their unweighted scores, in candidate order
+    struct Step {
+        std::u16string pattern;
+        std::vector<quint32> candidates;
+        std::vector<int> scores;
+    };
+
+    // Arenas shared by all candidates, the folded text keeps its case for smart case queries
+    std::vector<char16_t> m_folded;
+    std::vector<char16_t> m_lower;
+    std::vector<qint8> m_bonus;
+    std::vector<Candidate> m_candidates;
+    std::vector<quint64> m_masks;
+    std::vector<quint32> m_lengths;
+    qsizetype m_stride = 1;
+    bool m_weighted = false;
+
+    // Each step is a prefix of the one above it, so typing only rescans the previous matches and a backspace
+    // pops back to a step that was already scored
+    std::vector<Step> m_history;
+
+    // Scratch space reused between queries
+    std::vector<quint64> m_bits; // candidates passing the mask test
+    std::vector<quint32> m_survivors;
+    std::vector<int> m_first;
+    std::vector<int> m_scores;
+    std::vector<int> m_consecutive;
+
+    void appendCandidate(const QString& text);
+    void filter(const std::vector<quint32>* source, quint64 mask);
+    [[nodiscard]] int score(const Candidate& candidate, const char16_t* arena, const char16_t* pattern, qsizetype m);
+};
+
+} // namespace caelestia
+
+Q_DECLARE_INTERFACE(caelestia::SearchKeySource, "caelestia.SearchKeySource")
@@ -0,0 +1,157 @@
+#include "fuzzysearcher.hpp"
+
+#include <algorithm>
+
+namespace caelestia {
+
+FuzzySearcher::FuzzySearcher(QObject* parent)
+    : QObject(parent)
+    , m_keys({ QStringLiteral("name") })
+    , m_weights({ 1.0 })
+    , m_weighted(false)
+    , m_limit(0)
+    , m_dirty(true) {}
+
+QObjectList FuzzySearcher::list() const {
+    return m_list;
+}
+
+void FuzzySearcher::setList(const QObjectList& list) {
+    if (m_list == list) {
+        return;
+    }
+
+    m_list = list;
+    m_dirty = true;
+    emit listChanged();
+}
+
+QStringList FuzzySearcher::values() const {
+    return m_values;
+}
+
+void FuzzySearcher::setValues(const QStringList& values) {
+    if (m_values == values) {
+        return;
+    }
+
+    m_values = values;
+    m_dirty = true;
+    emit valuesChanged();
+}
+
+QStringList FuzzySearcher::keys() const {
+    return m_keys;
+}
+
+void FuzzySearcher::setKeys(const QStringList& keys) {
+    if (m_keys == keys) {
+        return;
+    }
+
+    m_keys = keys;
+    m_dirty = true;
+    emit keysChanged();
+}
+
+QList<qreal> FuzzySearcher::weights() const {
+    return m_weights;
+}
+
+void FuzzySearcher::setWeights(const QList<qreal>& weights) {
+    if (m_weights == weights) {
+        return;
+    }
+
+    m_weights = weights;
+    emit weightsChanged();
+}
+
+bool FuzzySearcher::weighted() const {
+    return m_weighted;
+}
+
+void FuzzySearcher::setWeighted(bool weighted) {
+    if (m_weighted == weighted) {
+        return;
+    }
+
+    m_weighted = weighted;
+    m_dirty = true;
+    emit weightedChanged();
+}
+
+int FuzzySearcher::limit() const {
+    return m_limit;
+}
+
+void FuzzySearcher::setLimit(int limit) {
+    if (m_limit == limit) {
+        return;
+    }
+
+    m_limit = limit;
+    emit limitChanged();
+}
+
+QObjectList FuzzySearcher::query(const QString& search) {
+    if (search.isEmpty()) {
+        return m_list;
+    }
+
+    findMatches(search);
+
+    QObjectList results;
+    results.reserve(static_cast<qsizetype>(m_matches.size()));
+    for (const auto& match : m_matches) {
+        results << m_list.at(match.index);
+    }
+    return results;
+}
+
+QList<int> FuzzySearcher::queryIndices(const QString& search) {
+    if (search.isEmpty()) {
+        return {};
+    }
+
+    findMatches(search);
+
+    QList<int> results;
+    results.reserve(static_cast<qsizetype>(m_matches.size()));
+    for (const auto& match : m_matches) {
+        results << static_cast<int>(match.index);
+    }
+    return results;
+}
+
+void FuzzySearcher::invalidate() {
+    m_dirty = true;
+}
+
+void FuzzySearcher::findMatches(const QString& search) {
+    if (m_dirty) {
+        m_dirty = false;
+        if (m_values.isEmpty()) {
+            m_matcher.prepare(FuzzyMatcher::readKeys(m_list, m_keys), m_weighted);
+        } else {
+            QList<QStringList> items;
+            items.reserve(m_values.size());
+            for (const auto& value : std::as_const(m_values)) {
+                items << QStringList{ value };
+            }
+            m_matcher.prepare(items, m_weighted);
+        }
+    }
+
+    m_matcher.match(search, m_weights, m_matches);
+
+    if (m_limit > 0 && static_cast<size_t>(m_limit) < m_matches.size()) {
+        const auto end = m_matches.begin() + m_limit;
+        std::partial_sort(m_matches.begin(), end, m_matches.end(), FuzzyMatcher::lessThan);
+        m_matches.erase(end, m_matches.end());
+    } else {
+        std::sort(m_matches.begin(), m_matches.end(), FuzzyMatcher::lessThan);
+    }
+}
+
+} // namespace caelestia
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "fuzzymatcher.hpp"
+#include <qobject.h>
+#include <qqmlintegration.h>
+#include <vector>
+
+namespace caelestia {
+
+class FuzzySearcher : public QObject {
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(QObjectList list READ list WRITE setList NOTIFY listChanged)
+    Q_PROPERTY(QStringList values READ values WRITE setValues NOTIFY valuesChanged)
+    Q_PROPERTY(QStringList keys READ keys WRITE setKeys NOTIFY keysChanged)
+    Q_PROPERTY(QList<qreal> weights READ weights WRITE setWeights NOTIFY weightsChanged)
+    Q_PROPERTY(bool weighted READ weighted WRITE setWeighted NOTIFY weightedChanged)
+    Q_PROPERTY(int limit READ limit WRITE setLimit NOTIFY limitChanged)
+
+public:
+    explicit FuzzySearcher(QObject* parent = nullptr);
+
+    [[nodiscard]] QObjectList list() const;
+    void setList(const QObjectList& list);
+
+    // One string per item to search in place of the keys of list, for sources with too many items to wrap each in an
+    // object. Use queryIndices with these.
+    [[nodiscard]] QStringList values() const;
+    void setValues(const QStringList& values);
+
+    [[nodiscard]] QStringList keys() const;
+    void setKeys(const QStringList& keys);
+
+    [[nodiscard]] QList<qreal> weights() const;
+    void setWeights(const QList<qreal>& weights);
+
+    [[nodiscard]] bool weighted() const;
+    void setWeighted(bool weighted);
+
+    [[nodiscard]] int limit() const;
+    void setLimit(int limit);
+
+    // Matching items, best first. Candidates are prepared lazily on the first query after the list or keys change.
+    Q_INVOKABLE QObjectList query(const QString& search);
+    // Same as query, but gives the indices of the matches. Empty for an empty search.
+    Q_INVOKABLE QList<int> queryIndices(const QString& search);
+
+    // Re-reads the keys of every item, for when their values change without the list itself changing
+    Q_INVOKABLE void invalidate();
+
+signals:
+    void listChanged();
+    void valuesChanged();
+    void keysChanged();
+    void weightsChanged();
+    void weightedChanged();
+    void limitChanged();
+
+private:
+    QObjectList m_list;
+    QStringList m_values;
+    QStringList m_keys;
+    QList<qreal> m_weights;
+    bool m_weighted;
+    int m_limit;
+    bool m_dirty;
+
+    FuzzyMatcher m_matcher;
+    std::vector<FuzzyMatcher::Match> m_matches;
+
+    void findMatches(const QString& search); // into m_matches, best first
+};
+
+} // namespace caelestia
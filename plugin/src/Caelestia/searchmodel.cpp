@@ -0,0 +1,275 @@
+#include "searchmodel.hpp"
+
+#include <algorithm>
+#include <qtconcurrentrun.h>
+
+namespace caelestia {
+
+SearchModel::SearchModel(QObject* parent)
+    : QAbstractListModel(parent)
+    , m_keys({ QStringLiteral("name") })
+    , m_weights({ 1.0 })
+    , m_weighted(false)
+    , m_pageSize(20)
+    , m_busy(false)
+    , m_itemsDirty(true)
+    , m_state(std::make_shared<State>()) {}
+
+QObjectList SearchModel::list() const {
+    return m_list;
+}
+
+void SearchModel::setList(const QObjectList& list) {
+    if (m_list == list) {
+        return;
+    }
+
+    m_list = list;
+    emit listChanged();
+
+    invalidate();
+}
+
+QStringList SearchModel::keys() const {
+    return m_keys;
+}
+
+void SearchModel::setKeys(const QStringList& keys) {
+    if (m_keys == keys) {
+        return;
+    }
+
+    m_keys = keys;
+    emit keysChanged();
+
+    invalidate();
+}
+
+QList<qreal> SearchModel::weights() const {
+    return m_weights;
+}
+
+void SearchModel::setWeights(const QList<qreal>& weights) {
+    if (m_weights == weights) {
+        return;
+    }
+
+    m_weights = weights;
+    emit weightsChanged();
+
+    search();
+}
+
+bool SearchModel::weighted() const {
+    return m_weighted;
+}
+
+void SearchModel::setWeighted(bool weighted) {
+    if (m_weighted == weighted) {
+        return;
+    }
+
+    m_weighted = weighted;
+    emit weightedChanged();
+
+    invalidate();
+}
+
+QString SearchModel::query() const {
+    return m_query;
+}
+
+void SearchModel::setQuery(const QString& query) {
+    if (m_query == query) {
+        return;
+    }
+
+    m_query = query;
+    emit queryChanged();
+
+    search();
+}
+
+int SearchModel::pageSize() const {
+    return m_pageSize;
+}
+
+void SearchModel::setPageSize(int size) {
+    if (m_pageSize == size) {
+        return;
+    }
+
+    m_pageSize = size;
+    emit pageSizeChanged();
+}
+
+bool SearchModel::busy() const {
+    return m_busy;
+}
+
+int SearchModel::count() const {
+    return static_cast<int>(m_results.size());
+}
+
+int SearchModel::rowCount(const QModelIndex& parent) const {
+    if (parent != QModelIndex()) {
+        return 0;
+    }
+    return static_cast<int>(m_results.size());
+}
+
+QVariant SearchModel::data(const QModelIndex& index, int role) const {
+    if (role != Qt::UserRole || !index.isValid() || index.row() >= m_results.size()) {
+        return QVariant();
+    }
+    return QVariant::fromValue(m_results.at(index.row()));
+}
+
+QHash<int, QByteArray> SearchModel::roleNames() const {
+    return { { Qt::UserRole, "modelData" } };
+}
+
+QObject* SearchModel::get(int row) const {
+    return m_results.value(row);
+}
+
+void SearchModel::invalidate() {
+    m_itemsDirty = true;
+    search();
+}
+
+void SearchModel::search() {
+    // Any search still running sees the new generation and gives up at its next check
+    const quint64 gen = ++m_state->generation;
+
+    if (m_query.isEmpty()) {
+        resetResults(m_list);
+        setBusy(false);
+        return;
+    }
+
+    // Properties can only be read on this thread, the worker prepares its candidates from this snapshot
+    if (m_itemsDirty) {
+        m_itemsDirty = false;
+        m_items = std::make_shared<const Items>(Items{ FuzzyMatcher::readKeys(m_list, m_keys), m_weighted });
+    }
+
+    setBusy(true);
+
+    const auto state = m_state;
+    const auto items = m_items;
+    const QString query = m_query;
+    const QList<qreal> weights = m_weights;
+    const auto pageSize = static_cast<size_t>(std::max(m_pageSize, 1));
+
+    QtConcurrent::run([state, items, query, weights, pageSize, gen]() -> Page {
+        QMutexLocker locker(&state->mutex);
+
+        const auto cancelled = [&state, gen]() {
+            return state->generation != gen;
+        };
+        if (cancelled()) {
+            return {};
+        }
+
+        if (state->prepared != items) {
+            state->matcher.prepare(items->values, items->weighted);
+            state->prepared = items;
+        }
+
+        if (!state->matcher.match(query, weights, state->matches, cancelled)) {
+            return {};
+        }
+
+        // Only rank the first page here, the rest is sorted after it has been shown
+        auto& matches = state->matches;
+        const auto page = std::min(pageSize, matches.size());
+        std::partial_sort(matches.begin(), matches.begin() + static_cast<qsizetype>(page), matches.end(),
+            FuzzyMatcher::lessThan);
+
+        Page result;
+        result.indices.reserve(static_cast<qsizetype>(page));
+        for (size_t i = 0; i < page; ++i) {
+            result.indices << matches[i].index;
+        }
+        result.more = page < matches.size();
+        return result;
+    }).then(this, [this, gen, pageSize](const Page& page) {
+        if (gen != m_state->generation) {
+            return;
+        }
+
+        QObjectList results;
+        results.reserve(page.indices.size());
+        for (const auto index : page.indices) {
+            results << m_list.at(index);
+        }
+        resetResults(results);
+
+        if (!page.more) {
+            setBusy(false);
+            return;
+        }
+
+        const auto state = m_state;
+        QtConcurrent::run([state, gen, pageSize]() -> Page {
+            QMutexLocker locker(&state->mutex);
+
+            // A newer search may have replaced the matches already
+            if (state->generation != gen) {
+                return {};
+            }
+
+            auto& matches = state->matches;
+            const auto rest = matches.begin() + static_cast<qsizetype>(pageSize);
+            std::sort(rest, matches.end(), FuzzyMatcher::lessThan);
+
+            Page result;
+            result.indices.reserve(static_cast<qsizetype>(matches.size() - pageSize));
+            for (auto it = rest; it != matches.end(); ++it) {
+                result.indices << it->index;
+            }
+            return result;
+        }).then(this, [this, gen](const Page& rest) {
+            if (gen != m_state->generation) {
+                return;
+            }
+
+            if (!rest.indices.isEmpty()) {
+                const auto first = static_cast<int>(m_results.size());
+                beginInsertRows(QModelIndex(), first, first + static_cast<int>(rest.indices.size()) - 1);
+                for (const auto index : rest.indices) {
+                    m_results << m_list.at(index);
+                }
+                endInsertRows();
+                emit countChanged();
+            }
+
+            setBusy(false);
+        });
+    });
+}
+
+void SearchModel::setBusy(bool busy) {
+    if (m_busy != busy) {
+        m_busy = busy;
+        emit busyChanged();
+    }
+}
+
+void SearchModel::resetResults(const QObjectList& results) {
+    if (m_results == results) {
+        return;
+    }
+
+    const bool countChanging = m_results.size() != results.size();
+    beginResetModel();
+    m_results = results;
+    endResetModel();
+
+    if (countChanging) {
+        emit countChanged();
+    }
+}
+
+} // namespace caelestia
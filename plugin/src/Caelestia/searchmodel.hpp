@@ -0,0 +1,107 @@
+#pragma once
+
+#include "fuzzymatcher.hpp"
+#include <atomic>
+#include <memory>
+#include <qabstractitemmodel.h>
+#include <qmutex.h>
+#include <qobject.h>
+#include <qqmlintegration.h>
+
+namespace caelestia {
+
+class SearchModel : public QAbstractListModel {
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(QObjectList list READ list WRITE setList NOTIFY listChanged)
+    Q_PROPERTY(QStringList keys READ keys WRITE setKeys NOTIFY keysChanged)
+    Q_PROPERTY(QList<qreal> weights READ weights WRITE setWeights NOTIFY weightsChanged)
+    Q_PROPERTY(bool weighted READ weighted WRITE setWeighted NOTIFY weightedChanged)
+    Q_PROPERTY(QString query READ query WRITE setQuery NOTIFY queryChanged)
+    Q_PROPERTY(int pageSize READ pageSize WRITE setPageSize NOTIFY pageSizeChanged)
+    Q_PROPERTY(bool busy READ busy NOTIFY busyChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    explicit SearchModel(QObject* parent = nullptr);
+
+    [[nodiscard]] QObjectList list() const;
+    void setList(const QObjectList& list);
+
+    [[nodiscard]] QStringList keys() const;
+    void setKeys(const QStringList& keys);
+
+    [[nodiscard]] QList<qreal> weights() const;
+    void setWeights(const QList<qreal>& weights);
+
+    [[nodiscard]] bool weighted() const;
+    void setWeighted(bool weighted);
+
+    [[nodiscard]] QString query() const;
+    void setQuery(const QString& query);
+
+    [[nodiscard]] int pageSize() const;
+    void setPageSize(int size);
+
+    [[nodiscard]] bool busy() const;
+    [[nodiscard]] int count() const;
+
+    [[nodiscard]] int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    [[nodiscard]] QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    [[nodiscard]] QHash<int, QByteArray> roleNames() const override;
+
+    Q_INVOKABLE QObject* get(int row) const;
+
+    // Re-reads the keys of every item, for when their values change without the list itself changing
+    Q_INVOKABLE void invalidate();
+
+signals:
+    void listChanged();
+    void keysChanged();
+    void weightsChanged();
+    void weightedChanged();
+    void queryChanged();
+    void pageSizeChanged();
+    void busyChanged();
+    void countChanged();
+
+private:
+    struct Items {
+        QList<QStringList> values;
+        bool weighted;
+    };
+
+    // Shared with the running searches so they can outlive the model
+    struct State {
+        QMutex mutex;
+        FuzzyMatcher matcher;
+        std::shared_ptr<const Items> prepared;
+        std::vector<FuzzyMatcher::Match> matches;
+        std::atomic<quint64> generation = 0;
+    };
+
+    struct Page {
+        QList<quint32> indices;
+        bool more = false;
+    };
+
+    QObjectList m_list;
+    QStringList m_keys;
+    QList<qreal> m_weights;
+    bool m_weighted;
+    QString m_query;
+    int m_pageSize;
+    bool m_busy;
+    bool m_itemsDirty;
+
+    std::shared_ptr<State> m_state;
+    std::shared_ptr<const Items> m_items;
+    QObjectList m_results;
+
+    void search();
+    void setBusy(bool busy);
+    void resetResults(const QObjectList& results);
+};
+
+} // namespace caelestia
@@ -19,6 +19,7 @@ Searcher {
     property string previewPath
     property string actualCurrent
     property bool previewColourLock
+    readonly property FileSystemModel files: wallpapers
 
     function setWallpaper(path: string): void {
         actualCurrent = path;
@@ -39,12 +40,13 @@ Searcher {
             Colours.showPreview = false;
     }
 
-    list: wallpapers.entries
-    key: "relativePath"
+    function itemAt(index: int): QtObject {
+        return wallpapers.get(index);
+    }
+
+    // Searched by path alone, only the wallpapers a query returns get an entry object
+    values: wallpapers.relativePaths
     useFuzzy: Config.launcher.useFuzzy.wallpapers
-    extraOpts: useFuzzy ? ({}) : ({
-            forward: false
-        })
 
     IpcHandler {
         function get(): string {
@@ -56,7 +58,7 @@ Searcher {
         }
 
         function list(): string {
-            return root.list.map(w => w.path).join("\n");
+            return wallpapers.paths.join("\n");
         }
 
         target: "wallpaper"
@@ -1,55 +1,72 @@
-import "scripts/fzf.js" as Fzf
-import "scripts/fuzzysort.js" as Fuzzy
 import QtQuick
 import Quickshell
+import Caelestia
 
 Singleton {
-    required property list<QtObject> list
+    id: root
+
+    property list<QtObject> list
     property string key: "name"
     property bool useFuzzy: false
-    property var extraOpts: ({})
 
-    // Extra stuff for fuzzy
+    // Keys are joined into one string unless useFuzzy, which scores each key separately and weights them
     property list<string> keys: [key]
     property list<real> weights: [1]
 
-    readonly property var fzf: useFuzzy ? [] : new Fzf.Finder(list, Object.assign({
-        selector
-    }, extraOpts))
-    readonly property list<var> fuzzyPrepped: useFuzzy ? list.map(e => {
-        const obj = {
-            _item: e
-        };
-        for (const k of keys)
-            obj[k] = Fuzzy.prepare(e[k]);
-        return obj;
-    }) : []
+    // Strings to search in place of the keys of list, one per item, for sources too big to wrap every item in an
+    // object. Matches are turned into items with itemAt, an empty search matches nothing so views show the source.
+    property list<string> values
 
-    function transformSearch(search: string): string {
-        return search;
+    function itemAt(index: int): QtObject {
+        return list[index];
     }
 
-    function selector(item: var): string {
-        // Only for fzf
-        return item[key];
+    // Searches off the GUI thread and streams the best results first, for views like LazyListView that take a model.
+    // Null until the first queryAsync so searchers only queried synchronously don't keep an idle model around.
+    property SearchModel results: null
+
+    function transformSearch(search: string): string {
+        return search;
     }
 
     function query(search: string): list<var> {
         search = transformSearch(search);
+        if (values.length > 0) {
+            if (!search)
+                return [];
+            return searcher.queryIndices(search).map(i => itemAt(i));
+        }
+
         if (!search)
             return [...list];
 
-        if (useFuzzy)
-            return Fuzzy.go(search, fuzzyPrepped, Object.assign({
-                all: true,
-                keys,
-                scoreFn: r => weights.reduce((a, w, i) => a + r[i].score * w, 0)
-            }, extraOpts)).map(r => r.obj._item);
-
-        return fzf.find(search).sort((a, b) => {
-            if (a.score === b.score)
-                return selector(a.item).trim().length - selector(b.item).trim().length;
-            return b.score - a.score;
-        }).map(r => r.item);
+        return searcher.query(search);
+    }
+
+    function queryAsync(search: string): void {
+        if (!results)
+            results = resultsComp.createObject(root);
+        results.query = transformSearch(search);
+    }
+
+    FuzzySearcher {
+        id: searcher
+
+        list: root.list
+        values: root.values
+        keys: root.keys
+        weights: root.weights
+        weighted: root.useFuzzy
+    }
+
+    Component {
+        id: resultsComp
+
+        SearchModel {
+            list: root.list
+            keys: root.keys
+            weights: root.weights
+            weighted: root.useFuzzy
+        }
     }
 }